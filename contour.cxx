@@ -13,6 +13,9 @@
 static void
 RunService(const vtkm::Id& step, xenia::utils::DataSetWriter& writer, vtkm::cont::PartitionedDataSet& pds, const boost::program_options::variables_map& vm)
 {
+  if (!writer.IsStepSelected(step))
+    return;
+
   std::string fieldName = vm["field"].as<std::string>();
   auto isoVals = vm["isovals"].as<std::vector<vtkm::FloatDefault>>();
 
@@ -29,7 +32,7 @@ RunService(const vtkm::Id& step, xenia::utils::DataSetWriter& writer, vtkm::cont
   auto result = contour.Execute(pds);
 
   std::cout<<"Contour step: "<<step<<" of "<<fieldName<<std::endl;
-  writer.BeginStep();
+  writer.BeginStep(step);
   writer.WriteDataSet(result);
   writer.EndStep();
 }
@@ -40,10 +43,16 @@ RunBP(const boost::program_options::variables_map& vm)
   std::cout<<"RunBP"<<std::endl;
   xenia::utils::DataSetReader reader(vm);
   xenia::utils::DataSetWriter writer(vm);
+  if (vm["read-all-blocks"].empty())
+  {
+    auto isoVals = vm["isovals"].as<std::vector<vtkm::FloatDefault>>();
+    reader.SetBlockValueFilter(vm["field"].as<std::string>(), std::vector<double>(isoVals.begin(), isoVals.end()));
+  }
+  if (vm["read-all-fields"].empty())
+    reader.SetFieldSelection({ vm["field"].as<std::string>() });
   reader.Init();
 
-  vtkm::Id numSteps = reader.GetNumSteps();
-  for (vtkm::Id step = 0; step < numSteps; step++)
+  for (const auto& step : reader.GetSelectedSteps())
   {
     auto output = reader.ReadDataSet(step);
 
@@ -76,16 +85,13 @@ RunSST(const boost::program_options::variables_map& vm)
   params["engine_type"] = "SST";
   reader.SetDataSourceParameters("source", params);
 
+  xenia::utils::StepWaitPolicy waitPolicy(vm);
+  xenia::utils::StepRange steps(vm, "steps");
   int step = 0;
-  while (true)
+  while (!steps.IsPast(step))
   {
-    auto status = reader.PrepareNextStep(paths);
-    if (status == fides::StepStatus::NotReady)
-    {
-      std::cout << "Not ready...." << std::endl;
-      continue;
-    }
-    else if (status == fides::StepStatus::EndOfStream)
+    auto status = waitPolicy.Wait([&reader, &paths]() { return reader.PrepareNextStep(paths); });
+    if (status == fides::StepStatus::EndOfStream)
     {
       std::cout << "Stream is done" << std::endl;
       break;
@@ -94,8 +100,10 @@ RunSST(const boost::program_options::variables_map& vm)
     fides::metadata::MetaData selections;
     //selections.Set(fides::keys::BLOCK_SELECTION(), blockSelection);
 
+    //Steps that are not selected still have to be read to move past them.
     auto output = reader.ReadDataSet(paths, selections);
-    RunService(step, writer, output, vm);
+    if (steps.Contains(step))
+      RunService(step, writer, output, vm);
 
     step++;
   }
@@ -114,8 +122,15 @@ int main(int argc, char** argv)
     ("output", po::value<std::string>(), "Output file")
     ("field", po::value<std::string>(), "field name in input data")
     ("isovals", po::value<std::vector<vtkm::FloatDefault>>(), "Isosurface values")
+    ("read-all-blocks", "Read every block, not only the blocks whose min/max holds an isovalue")
+    ("read-all-fields", "Read every field, not only --field")
     ("input_engine", po::value<std::string>(), "Adios2 input engine type (BP or SST")
     ("output_engine", po::value<std::string>(), "Adios2 output engine type (BP or SST")
+    ("output-steps", po::value<std::string>(), "Steps to write as start:stop:stride (default all). With SST output the other steps are not sent")
+    ("roi", po::value<std::vector<double>>()->multitoken(), "Region of interest `xmin xmax ymin ymax zmin zmax`. Only the blocks that overlap it are read (BP files), and uniform and rectilinear blocks are cut down to it")
+    ("steps", po::value<std::string>(), "Steps to read as start:stop:stride, e.g. ::10 for every 10th step (default all)")
+    ("step-timeout", po::value<double>(), "Seconds to wait for the next SST step before giving up (default waits forever)")
+    ("step-backoff-max", po::value<double>(), "Longest sleep in seconds between checks for the next SST step (default 1)")
     ;
 
   po::variables_map vm;
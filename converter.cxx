@@ -25,9 +25,9 @@ RunService(const vtkm::cont::PartitionedDataSet& input,
 }
 
 static void
-RunService2(xenia::utils::DataSetWriter& writer, const vtkm::cont::PartitionedDataSet& pds, const boost::program_options::variables_map& /*vm*/)
+RunService2(xenia::utils::DataSetWriter& writer, vtkm::Id step, const vtkm::cont::PartitionedDataSet& pds, const boost::program_options::variables_map& /*vm*/)
 {
-  writer.BeginStep();
+  writer.BeginStep(step);
   writer.WriteDataSet(pds);
   writer.EndStep();
 }
@@ -41,7 +41,7 @@ RunVTK(const boost::program_options::variables_map& vm)
 
   auto output = reader.ReadDataSet();
 
-  RunService2(writer, vtkm::cont::PartitionedDataSet{ output }, vm);
+  RunService2(writer, 0, vtkm::cont::PartitionedDataSet{ output }, vm);
 
   writer.Close();
 }
@@ -59,15 +59,12 @@ RunBP(const boost::program_options::variables_map& vm)
   xenia::utils::DataSetWriter writer(vm);
   reader.Init();
 
-  vtkm::Id numSteps = reader.GetNumSteps();
-
-  for (vtkm::Id step = 0; step < numSteps; step++)
+  while (reader.BeginStep() == fides::StepStatus::OK)
   {
-    reader.BeginStep();
     auto output = reader.Read();
     std::cout<<rank<<": has "<<output.GetNumberOfPartitions()<<std::endl;
 
-    RunService2(writer, output, vm);
+    RunService2(writer, reader.GetStep(), output, vm);
 
     reader.EndStep();
   }
@@ -104,7 +101,7 @@ RunBPBP(const boost::program_options::variables_map& vm)
   std::cout<<"Run: "<<inputFname<<" "<<inputEngineType<<" --> "<<outputFname<<" "<<outputEngineType<<std::endl;
 
   fides::io::DataSetReader reader(jsonFile);
-  fides::io::DataSetAppendWriter writer(outputFname);
+  xenia::utils::DataSetWriter writer(vm);
 
   std::unordered_map<std::string, std::string> paths;
   paths["source"] = inputFname;
@@ -118,7 +115,8 @@ RunBPBP(const boost::program_options::variables_map& vm)
   auto metaData = reader.ReadMetaData(paths);
   vtkm::Id totalNumSteps = metaData.Get<fides::metadata::Size>(fides::keys::NUMBER_OF_STEPS()).NumberOfItems;
 
-  for (vtkm::Id step = 0; step < totalNumSteps; step++)
+  xenia::utils::StepRange steps(vm, "steps");
+  for (const auto& step : steps.GetSteps(totalNumSteps))
   {
     if (sleepTime > 0)
       sleep(sleepTime);
@@ -130,8 +128,9 @@ RunBPBP(const boost::program_options::variables_map& vm)
     //input.PrintSummary(std::cout);
 
     auto output = RunService(input, vm);
-    writer.Write(output, outputEngineType);
+    RunService2(writer, step, output, vm);
   }
+  writer.Close();
 }
 
 static void
@@ -155,7 +154,7 @@ RunBPSST(const boost::program_options::variables_map& vm)
   }
 
   fides::io::DataSetReader reader(jsonFile);
-  fides::io::DataSetAppendWriter writer(outputFname);
+  xenia::utils::DataSetWriter writer(vm);
 
   std::unordered_map<std::string, std::string> paths;
   paths["source"] = inputFname;
@@ -169,7 +168,8 @@ RunBPSST(const boost::program_options::variables_map& vm)
   auto metaData = reader.ReadMetaData(paths);
   vtkm::Id totalNumSteps = metaData.Get<fides::metadata::Size>(fides::keys::NUMBER_OF_STEPS()).NumberOfItems;
 
-  for (vtkm::Id step = 0; step < totalNumSteps; step++)
+  xenia::utils::StepRange steps(vm, "steps");
+  for (const auto& step : steps.GetSteps(totalNumSteps))
   {
     std::cout<<"Step: "<<step<<std::endl;
     if (sleepTime > 0)
@@ -180,7 +180,7 @@ RunBPSST(const boost::program_options::variables_map& vm)
     //input.PrintSummary(std::cout);
 
     auto output = RunService(input, vm);
-    writer.Write(output, outputEngineType);
+    RunService2(writer, step, output, vm);
   }
 //  reader.Close();
   writer.Close();
@@ -206,7 +206,7 @@ RunSSTBP(const boost::program_options::variables_map& vm)
   }
 
   fides::io::DataSetReader reader(jsonFile);
-  fides::io::DataSetAppendWriter writer(outputFname);
+  xenia::utils::DataSetWriter writer(vm);
 
   std::unordered_map<std::string, std::string> paths;
   paths["source"] = inputFname;
@@ -217,32 +217,34 @@ RunSSTBP(const boost::program_options::variables_map& vm)
   params["engine_type"] = inputEngineType;
   reader.SetDataSourceParameters("source", params);
 
+  xenia::utils::StepWaitPolicy waitPolicy(vm);
+  xenia::utils::StepRange steps(vm, "steps");
   int step = 0;
-  while (true)
+  while (!steps.IsPast(step))
   {
     std::cout<<"Step: "<<step<<std::endl;
     if (sleepTime > 0)
       sleep(sleepTime);
 
-    auto status = reader.PrepareNextStep(paths);
-    if (status == fides::StepStatus::NotReady)
-	  {
-  	  std::cout << "Not ready...." << std::endl;
-	    continue;
-  	}
-    else if (status == fides::StepStatus::EndOfStream)
+    auto status = waitPolicy.Wait([&reader, &paths]() { return reader.PrepareNextStep(paths); });
+    if (status == fides::StepStatus::EndOfStream)
   	{
 	    std::cout << "Stream is done" << std::endl;
 	    break;
 	  }
 
+    //Steps that are not selected still have to be read to move past them.
     auto input = reader.ReadDataSet(paths, selections);
     //input.PrintSummary(std::cout);
 
-    auto output = RunService(input, vm);
-    writer.Write(output, outputEngineType);
+    if (steps.Contains(step))
+    {
+      auto output = RunService(input, vm);
+      RunService2(writer, step, output, vm);
+    }
     step++;
   }
+  writer.Close();
 }
 
 static void
@@ -265,7 +267,7 @@ RunSSTSST(const boost::program_options::variables_map& vm)
   }
 
   fides::io::DataSetReader reader(jsonFile);
-  fides::io::DataSetAppendWriter writer(outputFname);
+  xenia::utils::DataSetWriter writer(vm);
 
   std::unordered_map<std::string, std::string> paths;
   paths["source"] = inputFname;
@@ -276,39 +278,44 @@ RunSSTSST(const boost::program_options::variables_map& vm)
   params["engine_type"] = inputEngineType;
   reader.SetDataSourceParameters("source", params);
 
+  xenia::utils::StepWaitPolicy waitPolicy(vm);
+  xenia::utils::StepRange steps(vm, "steps");
   int step = 0;
-  while (true)
+  while (!steps.IsPast(step))
   {
     std::cout<<"Step: "<<step<<std::endl;
     if (sleepTime > 0)
       sleep(sleepTime);
 
-    auto status = reader.PrepareNextStep(paths);
-    if (status == fides::StepStatus::NotReady)
-	  {
-  	  std::cout << "Not ready...." << std::endl;
-	    continue;
-  	}
-    else if (status == fides::StepStatus::EndOfStream)
+    auto status = waitPolicy.Wait([&reader, &paths]() { return reader.PrepareNextStep(paths); });
+    if (status == fides::StepStatus::EndOfStream)
   	{
 	    std::cout << "Stream is done" << std::endl;
 	    break;
 	  }
 
+    //Steps that are not selected still have to be read to move past them.
     auto input = reader.ReadDataSet(paths, selections);
     //input.PrintSummary(std::cout);
 
-    auto output = RunService(input, vm);
-    writer.Write(output, outputEngineType);
+    if (steps.Contains(step))
+    {
+      auto output = RunService(input, vm);
+      RunService2(writer, step, output, vm);
+    }
     step++;
   }
+  writer.Close();
 }
 
 static void
 RunIT(const boost::program_options::variables_map& vm)
 {
-  std::string inputEngineType = vm["input_engine"].as<std::string>();
-  std::string outputEngineType = vm["output_engine"].as<std::string>();
+  std::string inputEngineType = "BPFile", outputEngineType = "BPFile";
+  if (!vm["input_engine"].empty())
+    inputEngineType = vm["input_engine"].as<std::string>();
+  if (!vm["output_engine"].empty())
+    outputEngineType = vm["output_engine"].as<std::string>();
   if (inputEngineType == "BPFile")
   {
     if (outputEngineType == "BPFile")
@@ -568,6 +575,12 @@ int main(int argc, char** argv)
     ("output", po::value<std::string>(), "Output file")
     ("input_engine", po::value<std::string>(), "Adios2 input engine type (BP, SST, or VTK)")
     ("output_engine", po::value<std::string>(), "Adios2 output engine type (BP or SST)")
+    ("steps", po::value<std::string>(), "Steps to convert as start:stop:stride, e.g. ::10 for every 10th step (default all)")
+    ("step-timeout", po::value<double>(), "Seconds to wait for the next SST step before giving up (default waits forever)")
+    ("step-backoff-max", po::value<double>(), "Longest sleep in seconds between checks for the next SST step (default 1)")
+    ("vtk-ascii", "Write ASCII instead of binary VTK files")
+    ("vtk-compress", "Compress the arrays of VTK XML (.pvd) output with zlib")
+    ("write-threads", po::value<int>(), "Threads used to write the VTK files of a rank (default is the cores on the node divided over the ranks on the node)")
     ;
 
   po::variables_map vm;
@@ -9,45 +9,124 @@
 #include <map>
 #include <typeindex>
 #include <numeric>
+#include <functional>
+#include <algorithm>
 
-#include <vtkm/cont/ArrayHandleRunTimeVec.h>
-#include <vtkm/cont/UnknownArrayHandle.h>
-
-template <typename T>
+//Writer blocks [b0, b1) that this rank copies: a contiguous range, so the output keeps the block order.
 static inline void
-ReadData(const std::string& varName, adios2::IO& io, adios2::Engine& reader, vtkm::cont::UnknownArrayHandle& arr, adios2::Dims& shape)
+GetRankBlocks(std::size_t numBlocks, int rank, int numProcs, std::size_t& b0, std::size_t& b1)
 {
-  auto var = io.InquireVariable<T>(varName);
-  shape = var.Shape();
-  std::size_t dataSz = std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<std::size_t>());
-  std::vector<T> res(dataSz);
-
-  reader.Get<T>(var, res.data(), adios2::Mode::Sync);
-  auto dataAH = vtkm::cont::make_ArrayHandle(res, vtkm::CopyFlag::On);
-  arr = vtkm::cont::UnknownArrayHandle(dataAH);
+  std::size_t r = static_cast<std::size_t>(rank), n = static_cast<std::size_t>(numProcs);
+  b0 = numBlocks * r / n;
+  b1 = numBlocks * (r + 1) / n;
 }
 
+//Copy this rank's writer blocks of one variable from the input step to the output step.
+//Whole blocks are copied, so every variable keeps the block layout (and block ids) of the writer.
+//With span, the data is read straight into the output engine's buffer. Otherwise it is read into a buffer
+//that is kept from step to step (it only grows) and put from there when the output step ends.
+//Single values are copied by rank 0.
 template <typename T>
 static inline void
-WriteData(const std::string& varName, adios2::IO& io, adios2::Engine& writer, const vtkm::cont::UnknownArrayHandle& arr, const adios2::Dims& varShape)
+CopyVariable(const std::string& varName,
+             adios2::IO& inIO,
+             adios2::Engine& reader,
+             adios2::IO& outIO,
+             adios2::Engine& writer,
+             bool useSpan,
+             int rank,
+             int numProcs,
+             std::vector<char>& buffer)
 {
-  std::vector<std::size_t> shape, start, count;
-  for (std::size_t i = 0; i < varShape.size(); i++)
+  auto vIn = inIO.InquireVariable<T>(varName);
+  adios2::Dims shape = vIn.Shape();
+
+  adios2::Variable<T> vOut = outIO.InquireVariable<T>(varName);
+  if (vIn.ShapeID() == adios2::ShapeID::GlobalValue)
+  {
+    if (!vOut)
+      vOut = outIO.DefineVariable<T>(varName);
+    if (rank != 0)
+      return;
+
+    if (buffer.size() < sizeof(T))
+      buffer.resize(sizeof(T));
+    //The writer copies a single value at Put, so it has to be read by then. It comes from the metadata.
+    T* data = reinterpret_cast<T*>(buffer.data());
+    reader.Get(vIn, data, adios2::Mode::Sync);
+    writer.Put(vOut, data, adios2::Mode::Deferred);
+    return;
+  }
+
+  auto blocks = reader.BlocksInfo(vIn, reader.CurrentStep());
+  std::size_t b0, b1;
+  GetRankBlocks(blocks.size(), rank, numProcs, b0, b1);
+
+  //One value per writer block.
+  if (vIn.ShapeID() == adios2::ShapeID::LocalValue)
   {
-    shape.push_back(varShape[i]);
-    count.push_back(varShape[i]);
-    start.push_back(0);
+    if (!vOut)
+      vOut = outIO.DefineVariable<T>(varName, {adios2::LocalValueDim});
+    for (std::size_t b = b0; b < b1; b++)
+    {
+      T value;
+      vIn.SetBlockSelection(b);
+      reader.Get(vIn, value, adios2::Mode::Sync);
+      writer.Put(vOut, value, adios2::Mode::Sync);
+    }
+    return;
   }
 
-  adios2::Variable<T> vOut = io.InquireVariable<T>(varName);
+  bool globalArray = (vIn.ShapeID() == adios2::ShapeID::GlobalArray);
   if (!vOut)
-    vOut = io.DefineVariable<T>(varName, shape, start, count);
+  {
+    //A local array needs a count, or ADIOS takes it for a single value. Each block sets its own below.
+    if (globalArray)
+      vOut = outIO.DefineVariable<T>(varName, shape);
+    else if (!blocks.empty())
+      vOut = outIO.DefineVariable<T>(varName, {}, {}, blocks[b0 < b1 ? b0 : 0].Count);
+    else
+      return;
+  }
+  else if (globalArray)
+    vOut.SetShape(shape);
 
-  if (!arr.CanConvert<vtkm::cont::ArrayHandleBasic<T>>())
-    throw std::string("Can convert type for " + varName);
+  auto getSize = [](const adios2::Dims& count)
+  { return std::accumulate(count.begin(), count.end(), std::size_t(1), std::multiplies<std::size_t>()); };
+
+  //Size the buffer for all the blocks first, since it must not move once data is put from it.
+  std::size_t dataSz = 0;
+  if (!useSpan)
+  {
+    for (std::size_t b = b0; b < b1; b++)
+      dataSz += getSize(blocks[b].Count);
+    if (buffer.size() < dataSz * sizeof(T))
+      buffer.resize(dataSz * sizeof(T));
+  }
 
-  auto dataArray = arr.AsArrayHandle<vtkm::cont::ArrayHandleBasic<T>>();
-  writer.Put(vOut, dataArray.GetReadPointer());
+  std::size_t offset = 0;
+  for (std::size_t b = b0; b < b1; b++)
+  {
+    const auto& info = blocks[b];
+    vIn.SetBlockSelection(b);
+    if (globalArray)
+      vOut.SetSelection({info.Start, info.Count});
+    else
+      vOut.SetSelection({adios2::Dims(), info.Count});
+
+    if (useSpan)
+    {
+      typename adios2::Variable<T>::Span span = writer.Put(vOut);
+      reader.Get(vIn, span.data(), adios2::Mode::Sync);
+    }
+    else
+    {
+      T* data = reinterpret_cast<T*>(buffer.data()) + offset;
+      reader.Get(vIn, data, adios2::Mode::Deferred);
+      writer.Put(vOut, data, adios2::Mode::Deferred);
+      offset += getSize(info.Count);
+    }
+  }
 }
 
 #define xeniaTemplateMacro(TYPE, call)               \
@@ -82,13 +161,6 @@ int main(int argc, char **argv)
     MPI_Finalize();
     return 0;
   }
-  if (numProcs != 1)
-  {
-    std::cerr<<"****************************************************"<<std::endl;
-    std::cerr<<" Error. This probably only works with 1 rank..."<<std::endl<<std::endl;
-    MPI_Finalize();
-    return 0;
-  }
 
   adios2::ADIOS adios(MPI_COMM_WORLD);
 
@@ -103,23 +175,34 @@ int main(int argc, char **argv)
   auto outIO = adios.DeclareIO("Output");
   auto writer = outIO.Open(outputFname, adios2::Mode::Write);
 
+  //The BP file engines can hand out their buffer (span), so the data is not copied on this side.
+  std::string writerType = writer.Type();
+  bool useSpan = (writerType.find("BP3") != std::string::npos ||
+                  writerType.find("BP4") != std::string::npos ||
+                  writerType.find("BP5") != std::string::npos);
+
+  //One buffer per variable, kept for the whole stream.
+  std::map<std::string, std::vector<char>> buffers;
+
   int step = 0;
   while (true)
   {
     auto status = reader.BeginStep();
     if (status != adios2::StepStatus::OK)
       break;
+    writer.BeginStep();
 
     auto variables = inIO.AvailableVariables();
-    std::cout<<"Reading Step= "<<step<<std::endl;
+    if (rank == 0)
+      std::cout<<"Reading Step= "<<step<<std::endl;
     for (const auto &vi : variables)
     {
-      vtkm::cont::UnknownArrayHandle arr;
-      adios2::Dims shape;
       auto varType = inIO.VariableType(vi.first);
-      xeniaTemplateMacro(varType, ReadData<VAR_TYPE>(vi.first, inIO, reader, arr, shape));
-      xeniaTemplateMacro(varType, WriteData<VAR_TYPE>(vi.first, outIO, writer, arr, shape));
+      auto& buffer = buffers[vi.first];
+      xeniaTemplateMacro(varType, CopyVariable<VAR_TYPE>(vi.first, inIO, reader, outIO, writer, useSpan, rank, numProcs, buffer));
     }
+    //The deferred reads must be done before the output step writes the buffers.
+    reader.PerformGets();
 
     if (step == 0)
     {
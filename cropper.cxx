@@ -19,6 +19,7 @@ int main(int argc, char** argv)
     ("json", po::value<std::string>(), "Fides JSON data model file")        
     ("output", po::value<std::string>(), "Output file")
     ("index", po::value<int>(), "Dataset index")
+    ("roi", po::value<std::vector<double>>()->multitoken(), "Region of interest `xmin xmax ymin ymax zmin zmax`")
     ;
 
   po::variables_map vm;
@@ -32,15 +33,24 @@ int main(int argc, char** argv)
   }
 
   xenia::utils::DataSetReader reader(vm);
+  reader.Init();
+  //Only read the selected block, not the whole dataset.
+  if (!vm["index"].empty())
+  {
+    int index = vm["index"].as<int>();
+    if (index < 0)
+      throw std::runtime_error("Error: index out of range.");
+    reader.SetBlockSelection({ static_cast<std::size_t>(index) });
+  }
+
   reader.BeginStep();
-  auto data = reader.ReadDataSet();
+  auto data = reader.Read();
   reader.EndStep();
-  int index = vm["index"].as<int>();
 
-  if (index < data.GetNumberOfPartitions())
+  if (data.GetNumberOfPartitions() > 0)
     xenia::utils::WriteData(data, vm["output"].as<std::string>());
   else
-    std::cerr<<"Error: index out of range."<<std::endl;
+    std::cerr<<"Error: Nothing to write. No data in the ROI."<<std::endl;
 
   MPI_Finalize();
   return 0;
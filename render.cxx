@@ -5,6 +5,7 @@
 
 #include <boost/program_options.hpp>
 #include "utils/ReadData.h"
+#include "utils/Render.h"
 #include "utils/WriteData.h"
 
 #include <vtkm/cont/Initialize.h>
@@ -24,130 +25,12 @@ using vtkm::rendering::MapperRayTracer;
 using vtkm::rendering::MapperVolume;
 using vtkm::rendering::MapperWireframer;
 
-std::string
-CreateOutputFileName(const std::string& fname, vtkm::Id step)
-{
- if (fname.find('%') != std::string::npos)
- {
-   char buffer[128];
-   snprintf(buffer, sizeof(buffer), fname.c_str(), step);
-   std::string outFname(buffer);
-   return outFname;
- }
- else
-   return fname;
-}
-
-vtkm::rendering::CanvasRayTracer
-MakeCanvas(const boost::program_options::variables_map& vm)
-{
-  vtkm::Vec<vtkm::Id,2> res(1024, 1024);
-
-  if (!vm["imagesize"].empty())
-  {
-    const auto& vals = vm["imagesize"].as<std::vector<int>>();
-    res[0] = static_cast<vtkm::Id>(vals[0]);
-    res[1] = static_cast<vtkm::Id>(vals[1]);
-  }
-
-  auto canvas =vtkm::rendering::CanvasRayTracer(res[0], res[1]);
-  return canvas;
-}
-
-vtkm::rendering::Camera
-MakeCamera(const boost::program_options::variables_map& vm)
-{
-  vtkm::rendering::Camera camera;
-  vtkm::Vec3f_32 position(1.5, 1.5, 1.5);
-  vtkm::Vec3f_32 lookAt(.5, .5, .5);
-  vtkm::Vec3f_32 up(0,1,0);
-  vtkm::FloatDefault fov = 60;
-  vtkm::Vec2f_32 clip(-1.0, 1.0);
-
-  if (!vm["position"].empty())
-  {
-    const auto& vals = vm["position"].as<std::vector<float>>();
-    for (std::size_t i = 0; i < 3; i++)
-      position[i] = vals[i];
-  }
-
-  if (!vm["lookat"].empty())
-  {
-    const auto& vals = vm["lookat"].as<std::vector<float>>();
-    for (int i = 0; i < 3; i++)
-      lookAt[i] = vals[i];
-  }
-  if (!vm["up"].empty())
-  {
-    const auto& vals = vm["up"].as<std::vector<float>>();
-    for (int i = 0; i < 3; i++)
-      up[i] = vals[i];
-  }
-  if (!vm["fov"].empty())
-  {
-    fov = vm["fov"].as<float>();
-  }
-  if (!vm["clip"].empty())
-  {
-    const auto& vals = vm["clip"].as<std::vector<vtkm::FloatDefault>>();
-    clip[0] = vals[0];
-    clip[1] = vals[1];
-  }
-
-/*
-  std::cout<<"Pos: "<<position<<std::endl;
-  std::cout<<"LookAt: "<<lookAt<<std::endl;
-  std::cout<<"Up: "<<up<<std::endl;
-  std::cout<<"Fov: "<<fov<<std::endl;
-  std::cout<<"clip "<<clip<<std::endl;
-*/
-  camera.SetPosition(position);
-  camera.SetLookAt(lookAt);
-  camera.SetViewUp(up);
-  camera.SetFieldOfView(fov);
-  camera.SetClippingRange(clip[0], clip[1]);
-
-  return camera;
-}
-
 static void
-RunService(const vtkm::Id& step, xenia::utils::DataSetWriter& writer, vtkm::cont::PartitionedDataSet& data, const boost::program_options::variables_map& vm)
+RunService(const vtkm::Id& step, xenia::utils::DataSetWriter& /*writer*/, vtkm::cont::PartitionedDataSet& data, const boost::program_options::variables_map& vm)
 {
-  std::string outputFile = vm["output"].as<std::string>();
-
-  auto canvas = MakeCanvas(vm);
-  auto camera = MakeCamera(vm);
-  std::string fieldName = vm["field"].as<std::string>();
-
-  vtkm::cont::ColorTable colorTable("inferno");
-  vtkm::rendering::Color bg(0.2f, 0.2f, 0.2f, 1.0f);
-
-  vtkm::Range scalarRange(0.0, 1.0);
-  if (!vm["scalar_range"].empty())
-  {
-    const auto& vals = vm["scalar_range"].as<std::vector<float>>();
-    scalarRange.Min = vals[0];
-    scalarRange.Max = vals[1];
-  }
-
-
-  vtkm::rendering::Scene scene;
-    for (const auto& ds : data)
-    {
-      vtkm::rendering::Actor actor(ds.GetCellSet(),
-                                  ds.GetCoordinateSystem(),
-                                  ds.GetField(fieldName),
-                                  colorTable);
-      actor.SetScalarRange(scalarRange);
-      scene.AddActor(actor);
-    }
-
-    vtkm::rendering::View3D view(scene, vtkm::rendering::MapperRayTracer(), canvas, camera, bg);
-
-    view.Paint();
-    auto fname = CreateOutputFileName(outputFile, step);
-    std::cout<<"Render step: "<<step<<" to "<<fname<<std::endl;
-    view.SaveAs(fname);
+  //One renderer for the whole stream.
+  static xenia::utils::Renderer renderer(vm);
+  renderer.Render(step, data);
 }
 
 static void
@@ -156,10 +39,11 @@ RunBP(const boost::program_options::variables_map& vm)
   std::cout<<"RunBP"<<std::endl;
   xenia::utils::DataSetReader reader(vm);
   xenia::utils::DataSetWriter writer(vm);
+  if (vm["read-all-fields"].empty() && !vm["field"].empty())
+    reader.SetFieldSelection({ vm["field"].as<std::string>() });
   reader.Init();
 
-  vtkm::Id numSteps = reader.GetNumSteps();
-  for (vtkm::Id step = 0; step < numSteps; step++)
+  for (const auto& step : reader.GetSelectedSteps())
   {
     auto output = reader.ReadDataSet(step);
 
@@ -192,16 +76,13 @@ RunSST(const boost::program_options::variables_map& vm)
   params["engine_type"] = "SST";
   reader.SetDataSourceParameters("source", params);
 
+  xenia::utils::StepWaitPolicy waitPolicy(vm);
+  xenia::utils::StepRange steps(vm, "steps");
   int step = 0;
-  while (true)
+  while (!steps.IsPast(step))
   {
-    auto status = reader.PrepareNextStep(paths);
-    if (status == fides::StepStatus::NotReady)
-    {
-      std::cout << "Not ready...." << std::endl;
-      continue;
-    }
-    else if (status == fides::StepStatus::EndOfStream)
+    auto status = waitPolicy.Wait([&reader, &paths]() { return reader.PrepareNextStep(paths); });
+    if (status == fides::StepStatus::EndOfStream)
     {
       std::cout << "Stream is done" << std::endl;
       break;
@@ -210,8 +91,10 @@ RunSST(const boost::program_options::variables_map& vm)
     fides::metadata::MetaData selections;
     //selections.Set(fides::keys::BLOCK_SELECTION(), blockSelection);
 
+    //Steps that are not selected still have to be read to move past them.
     auto output = reader.ReadDataSet(paths, selections);
-    RunService(step, writer, output, vm);
+    if (steps.Contains(step))
+      RunService(step, writer, output, vm);
 
     step++;
   }
@@ -229,6 +112,7 @@ int main(int argc, char** argv)
     ("json", po::value<std::string>(), "Fides JSON data model file")
     ("output", po::value<std::string>(), "Output file")
     ("field", po::value<std::string>(), "field name in input data")
+    ("read-all-fields", "Read every field, not only --field")
     ("position", po::value<std::vector<float>>()->multitoken(), "Camera position")
     ("lookat", po::value<std::vector<float>>()->multitoken(), "Camera look at position")
     ("up", po::value<std::vector<float>>()->multitoken(), "Camera up direction")
@@ -236,8 +120,21 @@ int main(int argc, char** argv)
     ("clip", po::value<std::vector<float>>()->multitoken(), "Clipping range")
     ("imagesize", po::value<std::vector<int>>()->multitoken(), "Image size")
     ("scalar_range", po::value<std::vector<float>>()->multitoken(), "Scalar rendering range")
+    ("scalar-range-mode", po::value<std::string>(), "How the scalar rendering range is found: fixed (default, --scalar_range), auto (each step), grow, smooth or freeze (first step)")
+    ("scalar-range-smoothing", po::value<double>(), "Weight of the newest step for --scalar-range-mode smooth (default 0.25)")
+    ("color-table", po::value<std::string>()->default_value("inferno"), "Color table")
+    ("render-mode", po::value<std::string>(), "surface (default) ray traces the cells, volume renders uniform or rectilinear grids directly, cylinder draws lines as cylinders of radius --tube-size")
+    ("tube-size", po::value<vtkm::FloatDefault>(), "Cylinder radius for --render-mode cylinder")
+    ("sample-distance", po::value<float>(), "Distance between samples along each ray for volume rendering")
+    ("opacity-points", po::value<std::vector<float>>()->multitoken(), "Volume rendering opacity as pairs of position in [0,1] of the scalar range and opacity (default 0 0 1 1)")
+    ("encode-threads", po::value<int>(), "Threads that encode and write PNG images in the background (default 2, 0 writes them on the render thread)")
+    ("encode-queue", po::value<int>(), "Most rendered images waiting to be written before rendering waits (default 4)")
     ("input_engine", po::value<std::string>(), "Adios2 input engine type (BP or SST")
     ("output_engine", po::value<std::string>(), "Adios2 output engine type (BP or SST")
+    ("roi", po::value<std::vector<double>>()->multitoken(), "Region of interest `xmin xmax ymin ymax zmin zmax`. Only the blocks that overlap it are read (BP files), and uniform and rectilinear blocks are cut down to it")
+    ("steps", po::value<std::string>(), "Steps to read as start:stop:stride, e.g. ::10 for every 10th step (default all)")
+    ("step-timeout", po::value<double>(), "Seconds to wait for the next SST step before giving up (default waits forever)")
+    ("step-backoff-max", po::value<double>(), "Longest sleep in seconds between checks for the next SST step (default 1)")
     ;
 
   po::variables_map vm;
@@ -1,4 +1,6 @@
 #include <mpi.h>
+#include <algorithm>
+#include <functional>
 #include <string>
 #include <vector>
 #include <boost/program_options.hpp>
@@ -6,11 +8,22 @@
 
 #include "utils/Debug.h"
 #include "utils/CommandLineArgParser.h"
+#include "utils/Cinema.h"
 #include "utils/ReadData.h"
+#include "utils/Render.h"
 #include "utils/WriteData.h"
+#include "utils/StepStream.h"
+#include "utils/Streamline.h"
+#include "utils/Timing.h"
 
 #include <vtkm/io/VTKDataSetReader.h>
 #include <vtkm/CellClassification.h>
+#include <vtkm/Version.h>
+#include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandleCounting.h>
+#include <vtkm/cont/EnvironmentTracker.h>
+#include <vtkm/thirdparty/diy/diy.h>
+#include <vtkm/thirdparty/diy/mpi-cast.h>
 #include <fides/DataSetReader.h>
 
 #include <vtkm/filter/contour/Contour.h>
@@ -82,6 +95,15 @@ AppendVTKFiles(const std::string& visitFileName, const std::vector<std::string>&
   fout.close();
 }
 
+//Collective the first time it is called (see xenia::utils::GetNumberOfWriteThreads), so RunIT calls it on every rank
+//before any rank can skip a write.
+static int
+GetNumberOfWriteThreads(const boost::program_options::variables_map& vm)
+{
+  static const int numThreads = xenia::utils::GetNumberOfWriteThreads(vm);
+  return numThreads;
+}
+
 static bool
 WriteVTK(const vtkm::cont::PartitionedDataSet& pds,
          int step,
@@ -102,106 +124,11 @@ WriteVTK(const vtkm::cont::PartitionedDataSet& pds,
   AppendVTKFiles(visitFileName, outputFileNames);
   std::cout<<"----WRITE "<<step<<" "<<visitFileName<<" "<<outputFileName[0]<<std::endl;
 
-  int blkIdx = 0;
-  for (const auto& ds : pds.GetPartitions())
-  {
-      vtkm::io::VTKDataSetWriter writer(outputFileNames[blkIdx]);
-      writer.WriteDataSet(ds);
-      blkIdx++;
-  }
+  xenia::utils::WriteVTKPartitions(pds, outputFileNames, vm.count("vtk-ascii") == 0, GetNumberOfWriteThreads(vm));
 
   return true;
 }
 
-std::string
-CreateOutputFileName(const std::string& fname, vtkm::Id step)
-{
- if (fname.find('%') != std::string::npos)
- {
-   char buffer[128];
-   snprintf(buffer, sizeof(buffer), fname.c_str(), step);
-   std::string outFname(buffer);
-   return outFname;
- }
- else
-   return fname;
-}
-
-vtkm::rendering::CanvasRayTracer
-MakeCanvas(const boost::program_options::variables_map& vm)
-{
-  vtkm::Vec<vtkm::Id,2> res(1024, 1024);
-
-  if (!vm["imagesize"].empty())
-  {
-    const auto& vals = vm["imagesize"].as<std::vector<int>>();
-    res[0] = static_cast<vtkm::Id>(vals[0]);
-    res[1] = static_cast<vtkm::Id>(vals[1]);
-  }
-
-  auto canvas =vtkm::rendering::CanvasRayTracer(res[0], res[1]);
-  return canvas;
-}
-
-vtkm::rendering::Camera
-MakeCamera(const boost::program_options::variables_map& vm)
-{
-  std::string outputFile = vm["output"].as<std::string>();
-
-  vtkm::rendering::Camera camera;
-  vtkm::Vec3f_32 position(1.5, 1.5, 1.5);
-  vtkm::Vec3f_32 lookAt(.5, .5, .5);
-  vtkm::Vec3f_32 up(0,1,0);
-  vtkm::FloatDefault fov = 60;
-  vtkm::Vec2f_32 clip(-1.0, 1.0);
-
-  if (!vm["position"].empty())
-  {
-    const auto& vals = vm["position"].as<std::vector<float>>();
-    for (std::size_t i = 0; i < 3; i++)
-      position[i] = vals[i];
-  }
-
-  if (!vm["lookat"].empty())
-  {
-    const auto& vals = vm["lookat"].as<std::vector<float>>();
-    for (int i = 0; i < 3; i++)
-      lookAt[i] = vals[i];
-  }
-  if (!vm["up"].empty())
-  {
-    const auto& vals = vm["up"].as<std::vector<float>>();
-    for (int i = 0; i < 3; i++)
-      up[i] = vals[i];
-  }
-  if (!vm["fov"].empty())
-  {
-    fov = vm["fov"].as<float>();
-  }
-  if (!vm["clip"].empty())
-  {
-    const auto& vals = vm["clip"].as<std::vector<vtkm::FloatDefault>>();
-    clip[0] = vals[0];
-    clip[1] = vals[1];
-  }
-
-/*
-  std::cout<<"Pos: "<<position<<std::endl;
-  std::cout<<"LookAt: "<<lookAt<<std::endl;
-  std::cout<<"Up: "<<up<<std::endl;
-  std::cout<<"Fov: "<<fov<<std::endl;
-  std::cout<<"clip "<<clip<<std::endl;
-*/
-  camera.SetPosition(position);
-  camera.SetLookAt(lookAt);
-  camera.SetViewUp(up);
-  camera.SetFieldOfView(fov);
-  camera.SetClippingRange(clip[0], clip[1]);
-
-  return camera;
-}
-
-
 template <typename T>
 static T GetParam(const boost::program_options::variables_map& vm, const char* param)
 {
@@ -305,13 +232,166 @@ static const std::vector<vtkm::Particle>& GetSeeds(const boost::program_options:
   return particles;
 }
 
+//Collective. The global block ids, if the blocks over all ranks are 0..N-1 as VTK-m expects.
+//When blocks were skipped (value filter, --roi) the ids are sparse, so none are returned and VTK-m numbers the
+//blocks densely by rank.
+static std::vector<vtkm::Id>
+GetDenseBlockIDs(const std::vector<vtkm::Id>& blockIDs, vtkm::Id numPartitions)
+{
+  vtkm::Id mismatch = (static_cast<vtkm::Id>(blockIDs.size()) != numPartitions ? 1 : 0);
+  vtkm::Id maxID = -1;
+  for (const auto& id : blockIDs)
+    maxID = std::max(maxID, id);
+
+  auto comm = vtkm::cont::EnvironmentTracker::GetCommunicator();
+  vtkm::Id totalCount = 0, globalMaxID = -1, globalMismatch = 0;
+  vtkmdiy::mpi::all_reduce(comm, numPartitions, totalCount, std::plus<vtkm::Id>());
+  vtkmdiy::mpi::all_reduce(comm, maxID, globalMaxID, vtkmdiy::mpi::maximum<vtkm::Id>());
+  vtkmdiy::mpi::all_reduce(comm, mismatch, globalMismatch, vtkmdiy::mpi::maximum<vtkm::Id>());
+
+  //The ids of the blocks read are distinct, so they cover 0..N-1 when the largest is N-1.
+  if (globalMismatch != 0 || totalCount == 0 || globalMaxID != totalCount-1)
+    return std::vector<vtkm::Id>();
+  return blockIDs;
+}
+
+//One renderer for the whole stream.
+static xenia::utils::Renderer& GetRenderer(const boost::program_options::variables_map& vm)
+{
+  static xenia::utils::Renderer renderer(vm);
+  return renderer;
+}
+
+static xenia::utils::CinemaDatabase& GetCinemaDatabase(const boost::program_options::variables_map& vm)
+{
+  static xenia::utils::CinemaDatabase cinema(vm);
+  return cinema;
+}
+
+//Fields kept by the contour: the contour field, the render field and --pass-fields.
+//An empty list keeps every field.
+static std::vector<std::string>
+GetContourFields(const boost::program_options::variables_map& vm)
+{
+  std::vector<std::string> fields;
+  if (vm["cell_to_point"].empty() && vm["pass-fields"].empty())
+    return fields;
+
+  fields.push_back(vm["field"].as<std::string>());
+  if (!vm["render-field"].empty())
+    fields.push_back(vm["render-field"].as<std::string>());
+  if (!vm["pass-fields"].empty())
+  {
+    for (const auto& name : vm["pass-fields"].as<std::vector<std::string>>())
+      fields.push_back(name);
+  }
+
+  std::sort(fields.begin(), fields.end());
+  fields.erase(std::unique(fields.begin(), fields.end()), fields.end());
+  return fields;
+}
+
+//Make the point fields in fieldNames. <field>_point is the average of the cell field <field>.
+//Only these fields are converted, and the output partitions keep only these fields.
 static vtkm::cont::PartitionedDataSet
-RunService(int step,
-           const vtkm::cont::PartitionedDataSet& input,
-	         const boost::program_options::variables_map& vm)
+CellToPoint(const vtkm::cont::PartitionedDataSet& input, const std::vector<std::string>& fieldNames)
 {
-  auto serviceType = vm["service"].as<std::string>();
+  const std::string suffix = "_point";
+  vtkm::cont::PartitionedDataSet output;
+  for (const auto& ds : input)
+  {
+    vtkm::cont::DataSet ds2;
+    ds2.SetCellSet(ds.GetCellSet());
+    for (vtkm::IdComponent i = 0; i < ds.GetNumberOfCoordinateSystems(); i++)
+      ds2.AddCoordinateSystem(ds.GetCoordinateSystem(i));
+
+    for (const auto& name : fieldNames)
+    {
+      if (ds.HasField(name))
+      {
+        ds2.AddField(ds.GetField(name));
+        continue;
+      }
 
+      bool isPointName = (name.size() > suffix.size() &&
+                          name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0);
+      std::string cellName = name.substr(0, name.size() - suffix.size());
+      if (!isPointName || !ds.HasCellField(cellName))
+        continue;
+
+      vtkm::filter::field_conversion::PointAverage avg;
+      avg.SetActiveField(cellName, vtkm::cont::Field::Association::Cells);
+      avg.SetOutputFieldName(name);
+      avg.SetFieldsToPass(vtkm::filter::FieldSelection(vtkm::filter::FieldSelection::Mode::None));
+      ds2.AddField(avg.Execute(ds).GetPointField(name));
+    }
+    output.AppendPartition(ds2);
+  }
+
+  return output;
+}
+
+static vtkm::cont::PartitionedDataSet
+RunContour(const vtkm::cont::PartitionedDataSet& input,
+           const std::string& fieldName,
+           const std::vector<vtkm::FloatDefault>& isoVals,
+           const std::vector<std::string>& passFields)
+{
+  vtkm::filter::contour::Contour contour;
+  contour.SetGenerateNormals(false);
+
+  contour.SetActiveField(fieldName);
+  for (int i = 0; i < isoVals.size(); i++)
+    contour.SetIsoValue(i, isoVals[i]);
+
+  if (passFields.empty())
+    contour.SetFieldsToPass(vtkm::filter::FieldSelection(vtkm::filter::FieldSelection::Mode::All));
+  else
+  {
+    vtkm::filter::FieldSelection selection(vtkm::filter::FieldSelection::Mode::Select);
+    for (const auto& name : passFields)
+      selection.AddField(name);
+    contour.SetFieldsToPass(selection);
+  }
+
+  return contour.Execute(input);
+}
+
+static const std::vector<std::string>& GetServiceChain(const boost::program_options::variables_map& vm)
+{
+  static std::vector<std::string> services;
+
+  if (services.empty())
+  {
+    std::string remaining = vm["service"].as<std::string>();
+    std::size_t pos = 0;
+    while ((pos = remaining.find(',')) != std::string::npos)
+    {
+      services.push_back(remaining.substr(0, pos));
+      remaining = remaining.substr(pos + 1);
+    }
+    services.push_back(remaining);
+
+    for (std::size_t i = 0; i < services.size(); i++)
+    {
+      if (services[i].empty())
+        throw std::runtime_error("Error: Empty service in `" + vm["service"].as<std::string>() + "`");
+      //render and cinema do not produce a dataset, so nothing can come after them.
+      if ((services[i] == "render" || services[i] == "cinema") && i != services.size()-1)
+        throw std::runtime_error("Error: " + services[i] + " must be the last service in the chain.");
+    }
+  }
+
+  return services;
+}
+
+static vtkm::cont::PartitionedDataSet
+RunServiceStage(const std::string& serviceType,
+                int step,
+                const vtkm::cont::PartitionedDataSet& input,
+                const std::vector<vtkm::Id>& blockIDs,
+                const boost::program_options::variables_map& vm)
+{
   vtkm::cont::PartitionedDataSet output;
   if (serviceType == "copier")
   {
@@ -325,43 +405,13 @@ RunService(int step,
   }
   else if (serviceType == "contour")
   {
-    vtkm::cont::PartitionedDataSet input2 = input;
     std::cout<<"Contour: step= "<<step<<std::endl;
     std::string fieldName = vm["field"].as<std::string>();
     auto isoVals = vm["isovals"].as<std::vector<vtkm::FloatDefault>>();
 
-    if (!vm["cell_to_point"].empty())
-    {
-      vtkm::Id numDS = input2.GetNumberOfPartitions();
-      for (vtkm::Id i = 0; i < numDS; i++)
-      {
-        auto ds = input2.GetPartition(i);
-        auto numFields = ds.GetNumberOfFields();
-        for (vtkm::IdComponent j = 0; j < numFields; j++)
-        {
-          auto field = ds.GetField(j);
-          if (field.IsCellField())
-          {
-            vtkm::filter::field_conversion::PointAverage avg;
-            avg.SetActiveField(field.GetName());
-            avg.SetOutputFieldName(field.GetName()+"_point");
-            ds = avg.Execute(ds);
-          }
-        }
-        input2.ReplacePartition(i, ds);
-      }
-    }
-    vtkm::filter::contour::Contour contour;
-    contour.SetGenerateNormals(false);
-
-    contour.SetActiveField(fieldName);
-    for (int i = 0; i < isoVals.size(); i++)
-      contour.SetIsoValue(i, isoVals[i]);
-
-    vtkm::filter::FieldSelection selection(vtkm::filter::FieldSelection::Mode::All);
-    contour.SetFieldsToPass(selection);
-
-    output = contour.Execute(input2);
+    auto fields = GetContourFields(vm);
+    auto input2 = (vm["cell_to_point"].empty() ? input : CellToPoint(input, fields));
+    output = RunContour(input2, fieldName, isoVals, fields);
   }
   else if (serviceType == "streamlines")
   {
@@ -384,32 +434,91 @@ RunService(int step,
     }
     auto seeds = GetSeeds(vm);
 
-    vtkm::filter::flow::Streamline streamline;
-    streamline.SetSeeds(seeds, vtkm::CopyFlag::Off);
-    streamline.SetStepSize(GetParam<vtkm::FloatDefault>(vm, "step-size"));
-    streamline.SetNumberOfSteps(GetParam<vtkm::Id>(vm, "max-steps"));
-    streamline.SetActiveField(fieldName);
+    std::string integrator = "rk4";
+    if (!vm["integrator"].empty())
+      integrator = vm["integrator"].as<std::string>();
+
+    if (integrator == "rk45")
+    {
+      auto stepSize = GetParam<vtkm::FloatDefault>(vm, "step-size");
+      vtkm::FloatDefault minStepSize = stepSize / 100, maxStepSize = stepSize * 100, tolerance = 1e-5f;
+      if (!vm["min-step-size"].empty())
+        minStepSize = vm["min-step-size"].as<vtkm::FloatDefault>();
+      if (!vm["max-step-size"].empty())
+        maxStepSize = vm["max-step-size"].as<vtkm::FloatDefault>();
+      if (!vm["tolerance"].empty())
+        tolerance = vm["tolerance"].as<vtkm::FloatDefault>();
+      if (minStepSize <= 0 || maxStepSize < minStepSize || tolerance <= 0)
+        throw std::runtime_error("Error. rk45 needs 0 < --min-step-size <= --max-step-size and --tolerance > 0.");
+
+      //rk45 does not pass particles between ranks.
+      static bool warned = false;
+      auto comm = vtkm::cont::EnvironmentTracker::GetCommunicator();
+      if (!warned && comm.size() > 1)
+      {
+        if (comm.rank() == 0)
+          std::cerr<<"Warning: --integrator rk45 stops streamlines at the blocks of each rank. Use rk4 to trace across ranks."<<std::endl;
+        warned = true;
+      }
 
-    output = streamline.Execute(input2);
+      xenia::utils::AdaptiveStreamline streamline;
+      streamline.SetSeeds(seeds);
+      streamline.SetStepSize(stepSize);
+      streamline.SetStepSizeRange(minStepSize, maxStepSize);
+      streamline.SetTolerance(tolerance);
+      streamline.SetNumberOfSteps(GetParam<vtkm::Id>(vm, "max-steps"));
+      streamline.SetActiveField(fieldName);
+      output = streamline.Execute(input2);
+    }
+    else if (integrator == "rk4")
+    {
+      vtkm::filter::flow::Streamline streamline;
+      streamline.SetSeeds(seeds, vtkm::CopyFlag::Off);
+      streamline.SetStepSize(GetParam<vtkm::FloatDefault>(vm, "step-size"));
+      streamline.SetNumberOfSteps(GetParam<vtkm::Id>(vm, "max-steps"));
+      streamline.SetActiveField(fieldName);
+
+      //Particles that leave the blocks of a rank are sent to the rank that owns the next block.
+      //VTK-m numbers the blocks by rank unless it is given the global ids.
+      auto denseIDs = GetDenseBlockIDs(blockIDs, input2.GetNumberOfPartitions());
+      if (!denseIDs.empty())
+        streamline.SetBlockIDs(denseIDs);
+      if (!vm["streamline-threads"].empty())
+        streamline.SetUseThreadedAlgorithm(true);
+#if VTKM_VERSION_MAJOR > 2 || (VTKM_VERSION_MAJOR == 2 && VTKM_VERSION_MINOR >= 1)
+      if (!vm["streamline-async"].empty())
+        streamline.SetUseAsynchronousCommunication();
+#endif
+
+      output = streamline.Execute(input2);
+    }
+    else
+      throw std::runtime_error("Error. Unknown integrator: " + integrator);
+
+    bool addAttributes = !vm["streamline-attributes"].empty();
     for (vtkm::Id i = 0; i < output.GetNumberOfPartitions(); i++)
     {
       auto ds = output.GetPartition(i);
-      auto numCells = ds.GetNumberOfPoints(); //Cells();
-      std::vector<vtkm::FloatDefault> ids;
-      ids.reserve(numCells);
-      for (int id = 0; id < numCells; id++)
+      if (addAttributes)
+        ds = xenia::utils::AddStreamlineAttributes(ds, GetParam<vtkm::FloatDefault>(vm, "step-size"));
+
+      //Point index over the number of points.
+      vtkm::Id numPoints = ds.GetNumberOfPoints();
+      if (numPoints > 0)
       {
-        vtkm::FloatDefault idVal = static_cast<vtkm::FloatDefault>(id) / static_cast<vtkm::FloatDefault>(numCells);
-        ids.push_back(idVal);
+        vtkm::cont::ArrayHandle<vtkm::FloatDefault> ids;
+        vtkm::FloatDefault delta = 1 / static_cast<vtkm::FloatDefault>(numPoints);
+        vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandleCounting<vtkm::FloatDefault>(0, delta, numPoints), ids);
+        ds.AddPointField("IDs", ids);
       }
-      ds.AddPointField("IDs", ids);
       output.ReplacePartition(i, ds);
     }
 
-    if (!vm["tube-size"].empty())
+    //The renderer draws polylines as cylinders (--render-mode cylinder), so tube geometry is only made on request.
+    if (!vm["tube-geometry"].empty())
     {
       vtkm::filter::geometry_refinement::Tube tubes;
-      tubes.SetRadius(vm["tube-size"].as<vtkm::FloatDefault>());
+      tubes.SetRadius(GetParam<vtkm::FloatDefault>(vm, "tube-size"));
       if (!vm["tube-num-sides"].empty())
         tubes.SetNumberOfSides(vm["tube-num-sides"].as<vtkm::IdComponent>());
       vtkm::filter::FieldSelection selection(vtkm::filter::FieldSelection::Mode::All);
@@ -420,8 +529,8 @@ RunService(int step,
       for (vtkm::Id i = 0; i < output.GetNumberOfPartitions(); i++)
       {
         auto ds = output.GetPartition(i);
-        vtkm::Id npts = ds.GetNumberOfPoints();
-        std::vector<vtkm::FloatDefault> scalars(npts, 1.0);
+        vtkm::cont::ArrayHandle<vtkm::FloatDefault> scalars;
+        scalars.AllocateAndFill(ds.GetNumberOfPoints(), 1);
         ds.AddPointField("scalar", scalars);
         output.ReplacePartition(i, ds);
       }
@@ -429,50 +538,22 @@ RunService(int step,
   }
   else if (serviceType == "render")
   {
-    std::string outputFile = vm["output"].as<std::string>();
-
-    auto canvas = MakeCanvas(vm);
-    auto camera = MakeCamera(vm);
-    std::string fieldName = "";
-    if (!vm["field"].empty())
-      fieldName = vm["field"].as<std::string>();
-
-    //use the raytracer.
-    if (!fieldName.empty())
-    {
-      vtkm::cont::ColorTable colorTable("Cool to Warm"); //("inferno");
-      vtkm::rendering::Color bg(0.2f, 0.2f, 0.2f, 1.0f);
-
-      vtkm::Range scalarRange(0.0, 1.0);
-      if (!vm["scalar_range"].empty())
-      {
-        const auto& vals = vm["scalar_range"].as<std::vector<float>>();
-        scalarRange.Min = vals[0];
-        scalarRange.Max = vals[1];
-      }
-
-      vtkm::rendering::Scene scene;
-        for (const auto& ds : input)
-        {
-          vtkm::rendering::Actor actor(ds.GetCellSet(),
-                                      ds.GetCoordinateSystem(),
-                                      ds.GetField(fieldName),
-                                      colorTable);
-          actor.SetScalarRange(scalarRange);
-          scene.AddActor(actor);
-        }
-
-      vtkm::rendering::View3D view(scene, vtkm::rendering::MapperRayTracer(), canvas, camera, bg);
-      view.SetWorldAnnotationsEnabled(false);
-      view.SetRenderAnnotationsEnabled(false);
-
-      view.Paint();
-      auto fname = CreateOutputFileName(outputFile, step);
-      std::cout<<"Render step: "<<step<<" to "<<fname<<std::endl;
-      view.SaveAs(fname);
-    }
-    else //wireframe mapper
+    GetRenderer(vm).Render(step, input);
+  }
+  else if (serviceType == "cinema")
+  {
+    auto& cinema = GetCinemaDatabase(vm);
+    if (vm["isovals"].empty())
+      cinema.Render(step, input);
+    else
     {
+      //One contour per isovalue, each rendered from every camera.
+      std::string fieldName = vm["field"].as<std::string>();
+      auto isoVals = vm["isovals"].as<std::vector<vtkm::FloatDefault>>();
+      auto fields = GetContourFields(vm);
+      auto input2 = (vm["cell_to_point"].empty() ? input : CellToPoint(input, fields));
+      for (std::size_t i = 0; i < isoVals.size(); i++)
+        cinema.Render(step, RunContour(input2, fieldName, { isoVals[i] }, fields), i, isoVals[i]);
     }
   }
   else
@@ -483,6 +564,26 @@ RunService(int step,
   return output;
 }
 
+//Run each service in the chain, passing the output of one directly to the next.
+static vtkm::cont::PartitionedDataSet
+RunService(int step,
+           const vtkm::cont::PartitionedDataSet& input,
+           const std::vector<vtkm::Id>& blockIDs,
+           const boost::program_options::variables_map& vm,
+           xenia::utils::StepTimer& timer)
+{
+  vtkm::cont::PartitionedDataSet data = input;
+  const auto& services = GetServiceChain(vm);
+  for (std::size_t i = 0; i < services.size(); i++)
+  {
+    xenia::utils::StepTimer::Scope scope(timer, step, services[i]);
+    //The block ids are for the partitions that were read.
+    data = RunServiceStage(services[i], step, data, (i == 0 ? blockIDs : std::vector<vtkm::Id>()), vm);
+  }
+
+  return data;
+}
+
 static void
 RunService2(xenia::utils::DataSetWriter& writer, const vtkm::cont::PartitionedDataSet& pds, const boost::program_options::variables_map& /*vm*/)
 {
@@ -505,283 +606,39 @@ RunVTK(const boost::program_options::variables_map& vm)
   writer.Close();
 }
 
-static void
-RunBP(const boost::program_options::variables_map& vm)
-{
-  int rank = 0, numProcs = 1;
-#ifdef ENABLE_MPI
-  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-  MPI_Comm_size(MPI_COMM_WORLD, &numProcs);
-#endif
-  std::cout<<"RunBP"<<std::endl;
-  xenia::utils::DataSetReader reader(vm);
-  xenia::utils::DataSetWriter writer(vm);
-  reader.Init();
-
-  vtkm::Id numSteps = reader.GetNumSteps();
-
-  for (vtkm::Id step = 0; step < numSteps; step++)
-  {
-    reader.BeginStep();
-    auto output = reader.Read();
-    std::cout<<rank<<": has "<<output.GetNumberOfPartitions()<<std::endl;
-
-    RunService2(writer, output, vm);
-
-    reader.EndStep();
-  }
-
-  writer.Close();
-}
-
-vtkm::cont::PartitionedDataSet
-ReadBPFile(fides::io::DataSetReader* reader,const boost::program_options::variables_map& vm)
-{
-  vtkm::cont::PartitionedDataSet pds;
-
-  return pds;
-}
-
-static void
-RunBPBP(const boost::program_options::variables_map& vm)
-{
-  std::string inputFname = vm["file"].as<std::string>();
-  std::string outputFname = vm["output"].as<std::string>();
-  std::string inputEngineType = "BPFile";
-  std::string outputEngineType = "BPFile";
-
-  std::string jsonFile = "";
-  if (!vm["json"].empty())
-    jsonFile = vm["json"].as<std::string>();
-
-  int sleepTime = 0;
-  if (!vm["sleep"].empty())
-  {
-    sleepTime = vm["sleep"].as<int>();
-  }
-
-  std::cout<<"Run: "<<inputFname<<" "<<inputEngineType<<" --> "<<outputFname<<" "<<outputEngineType<<std::endl;
-
-  fides::io::DataSetReader reader(jsonFile);
-  fides::io::DataSetAppendWriter writer(outputFname);
-
-  std::unordered_map<std::string, std::string> paths;
-  paths["source"] = inputFname;
-
-  fides::DataSourceParams params;
-  fides::metadata::MetaData selections;
-
-  params["engine_type"] = inputEngineType;
-  reader.SetDataSourceParameters("source", params);
-
-  auto metaData = reader.ReadMetaData(paths);
-  vtkm::Id totalNumSteps = metaData.Get<fides::metadata::Size>(fides::keys::NUMBER_OF_STEPS()).NumberOfItems;
-
-  for (vtkm::Id step = 0; step < totalNumSteps; step++)
-  {
-    if (sleepTime > 0)
-      sleep(sleepTime);
-    std::cout<<"Step: "<<step<<" of "<<totalNumSteps<<std::endl;
-
-    selections.Set(fides::keys::STEP_SELECTION(), fides::metadata::Index(step));
-
-    auto input = reader.ReadDataSet(paths, selections);
-    if (input.GetNumberOfPartitions() == 0)
-      continue;
-    auto output = RunService(step, input, vm);
-    if (output.GetNumberOfPartitions() > 0)
-      writer.Write(output, outputEngineType);
-  }
-}
-
-static void
-RunBPSST(const boost::program_options::variables_map& vm)
-{
-  std::string inputFname = vm["file"].as<std::string>();
-  std::string outputFname = vm["output"].as<std::string>();
-  std::string inputEngineType = "BPFile";
-  std::string outputEngineType = "SST";
-
-  std::cout<<"Run: "<<inputFname<<" "<<inputEngineType<<" --> "<<outputFname<<" "<<outputEngineType<<std::endl;
-
-  std::string jsonFile = "";
-  if (!vm["json"].empty())
-    jsonFile = vm["json"].as<std::string>();
-
-  int sleepTime = 0;
-  if (!vm["sleep"].empty())
-  {
-    sleepTime = vm["sleep"].as<int>();
-  }
-
-  fides::io::DataSetReader reader(jsonFile);
-  fides::io::DataSetAppendWriter writer(outputFname);
-
-  std::unordered_map<std::string, std::string> paths;
-  paths["source"] = inputFname;
-
-  fides::DataSourceParams params;
-  fides::metadata::MetaData selections;
-
-  params["engine_type"] = inputEngineType;
-  reader.SetDataSourceParameters("source", params);
-
-  auto metaData = reader.ReadMetaData(paths);
-  vtkm::Id totalNumSteps = metaData.Get<fides::metadata::Size>(fides::keys::NUMBER_OF_STEPS()).NumberOfItems;
-
-  std::cout<<"JSON= "<<jsonFile<<std::endl;
-  for (vtkm::Id step = 0; step < totalNumSteps; step++)
-  {
-    std::cout<<"Step: "<<step<<std::endl;
-    if (sleepTime > 0)
-      sleep(sleepTime);
-    selections.Set(fides::keys::STEP_SELECTION(), fides::metadata::Index(step));
-
-    auto input = reader.ReadDataSet(paths, selections);
-    auto output = RunService(step, input, vm);
-    //output.PrintSummary(std::cout);
-
-    if (output.GetNumberOfPartitions() > 0)
-      writer.Write(output, "SST"); //outputEngineType);
-  }
-//  reader.Close();
-  writer.Close();
-}
-
-static void
-RunSSTBP(const boost::program_options::variables_map& vm)
+//Fields read for the first service in the chain. Empty reads every field.
+static std::vector<std::string>
+GetInputFields(const boost::program_options::variables_map& vm)
 {
-  std::string inputFname = vm["file"].as<std::string>();
-  std::string outputFname = vm["output"].as<std::string>();
-  std::string inputEngineType = "SST";
-  std::string outputEngineType = "BPFile";
-
-  std::cout<<"Run: "<<inputFname<<" "<<inputEngineType<<" --> "<<outputFname<<" "<<outputEngineType<<std::endl;
-
-  std::string jsonFile = "";
-  if (!vm["json"].empty())
-    jsonFile = vm["json"].as<std::string>();
-  int sleepTime = 0;
-  if (!vm["sleep"].empty())
+  std::vector<std::string> fields;
+  const auto& service = GetServiceChain(vm)[0];
+  if (service == "contour" || (service == "cinema" && !vm["isovals"].empty()))
   {
-    sleepTime = vm["sleep"].as<int>();
-  }
-
-  std::unique_ptr<fides::io::DataSetReader> FidesReader;
-  if (jsonFile.empty())
-  {
-      FidesReader = std::unique_ptr<fides::io::DataSetReader>(new fides::io::DataSetReader(inputFname, fides::io::DataSetReader::DataModelInput::BPFile));
+    fields.push_back(vm["field"].as<std::string>());
+    if (!vm["pass-fields"].empty())
+    {
+      for (const auto& name : vm["pass-fields"].as<std::vector<std::string>>())
+        fields.push_back(name);
+    }
   }
-  else
+  else if (service == "streamlines")
   {
-    if (inputEngineType == "BPFile")
-      FidesReader = std::unique_ptr<fides::io::DataSetReader>(new fides::io::DataSetReader(jsonFile));
-    else
-      FidesReader = std::unique_ptr<fides::io::DataSetReader>(new fides::io::DataSetReader(jsonFile, fides::io::DataSetReader::DataModelInput::JSONFile, true));
-  }
-
-  //fides::io::DataSetReader reader(jsonFile);
-  fides::io::DataSetAppendWriter writer(outputFname);
-
-  std::unordered_map<std::string, std::string> paths;
-  paths["source"] = inputFname;
-
-  fides::DataSourceParams params;
-  fides::metadata::MetaData selections;
-
-  params["engine_type"] = inputEngineType;
-  FidesReader->SetDataSourceParameters("source", params);
-
-  std::cout<<"JSONFile: "<<jsonFile<<std::endl;
-
-  int step = 0;
-  while (true)
-  {
-    std::cout<<"Step: "<<step<<std::endl;
-    if (sleepTime > 0)
-      sleep(sleepTime);
-
-    auto status = FidesReader->PrepareNextStep(paths);
-    if (status == fides::StepStatus::NotReady)
-	  {
-  	  std::cout << "Not ready...." << std::endl;
-	    continue;
-  	}
-    else if (status == fides::StepStatus::EndOfStream)
-  	{
-	    std::cout << "Stream is done" << std::endl;
-	    break;
-	  }
-
-    auto input = FidesReader->ReadDataSet(paths, selections);
-    //input.PrintSummary(std::cout);
-
-    auto output = RunService(step, input, vm);
-
-    if (output.GetNumberOfPartitions() > 0)
-      writer.Write(output, outputEngineType);
-    step++;
+    if (!vm["field"].empty())
+      fields.push_back(vm["field"].as<std::string>());
+    else if (!vm["fieldx"].empty())
+      fields = GetComponentFieldList(vm);
   }
-}
-
-static void
-RunSSTSST(const boost::program_options::variables_map& vm)
-{
-  std::string inputFname = vm["file"].as<std::string>();
-  std::string outputFname = vm["output"].as<std::string>();
-  std::string inputEngineType = "SST";
-  std::string outputEngineType = "SST";
-
-  std::cout<<"Run: "<<inputFname<<" "<<inputEngineType<<" --> "<<outputFname<<" "<<outputEngineType<<std::endl;
+  else if ((service == "render" || service == "cinema") && vm["render-field"].empty() && !vm["field"].empty())
+    fields.push_back(vm["field"].as<std::string>());
 
-  std::string jsonFile = "";
-  if (!vm["json"].empty())
-    jsonFile = vm["json"].as<std::string>();
-  int sleepTime = 0;
-  if (!vm["sleep"].empty())
+  //The render field comes from the input unless an earlier service makes it.
+  if (!fields.empty() || service == "render" || service == "cinema")
   {
-    sleepTime = vm["sleep"].as<int>();
+    if (!vm["render-field"].empty())
+      fields.push_back(vm["render-field"].as<std::string>());
   }
 
-  fides::io::DataSetReader reader(jsonFile);
-  fides::io::DataSetAppendWriter writer(outputFname);
-
-  std::unordered_map<std::string, std::string> paths;
-  paths["source"] = inputFname;
-
-  fides::DataSourceParams params;
-  fides::metadata::MetaData selections;
-
-  params["engine_type"] = inputEngineType;
-  reader.SetDataSourceParameters("source", params);
-
-  int step = 0;
-  while (true)
-  {
-    std::cout<<"Step: "<<step<<std::endl;
-    if (sleepTime > 0)
-      sleep(sleepTime);
-
-    auto status = reader.PrepareNextStep(paths);
-    if (status == fides::StepStatus::NotReady)
-	  {
-  	  std::cout << "Not ready...." << std::endl;
-	    continue;
-  	}
-    else if (status == fides::StepStatus::EndOfStream)
-  	{
-	    std::cout << "Stream is done" << std::endl;
-	    break;
-	  }
-
-    auto input = reader.ReadDataSet(paths, selections);
-    //input.PrintSummary(std::cout);
-
-    auto output = RunService(step, input, vm);
-    if (output.GetNumberOfPartitions() > 0)
-      writer.Write(output, outputEngineType);
-    step++;
-  }
+  return fields;
 }
 
 static void
@@ -793,249 +650,77 @@ RunIT(const boost::program_options::variables_map& vm)
   if (!vm["output_engine"].empty())
     outputEngineType = vm["output_engine"].as<std::string>();
 
-  if (inputEngineType == "BPFile")
-  {
-    if (outputEngineType == "BPFile")
-      RunBPBP(vm);
-    else if (outputEngineType == "SST")
-      RunBPSST(vm);
-    else
-    {
-      std::cout<<"ERROR: unknown output engine: "<<outputEngineType<<std::endl;
-      return;
-    }
-  }
-  else if (inputEngineType == "SST")
-  {
-    if (outputEngineType == "BPFile")
-      RunSSTBP(vm);
-    else if (outputEngineType == "SST")
-      RunSSTSST(vm);
-    else
-    {
-      std::cout<<"ERROR: unknown output engine: "<<outputEngineType<<std::endl;
-      return;
-    }
-  }
-  else
-  {
-    std::cout<<"ERROR: unknown input engine: "<<outputEngineType<<std::endl;
-    return;
-  }
-  //RunBPSST(vm);
-  //RunSSTBP(vm);
-  return;
-
-#if 0
   std::string inputFname = vm["file"].as<std::string>();
   std::string outputFname = vm["output"].as<std::string>();
+  std::cout<<"Run: "<<inputFname<<" "<<inputEngineType<<" --> "<<outputFname<<" "<<outputEngineType<<std::endl;
 
-  std::string inputEngineType = "BPFile";
-  std::string outputEngineType = "BPFile";
-  if (!vm["input_engine"].empty())
-    inputEngineType = vm["input_engine"].as<std::string>();
-  if (!vm["output_engine"].empty())
-    outputEngineType = vm["output_engine"].as<std::string>();    
-  
-  std::cout<<"Run:: "<<inputFname<< " _"<<inputEngineType<<"_ --> ";
-  std::cout<<outputFname<<" _"<<outputEngineType<<"_"<<std::endl;
-						      
-  std::string jsonFile = "";
-  if (!vm["json"].empty())
-    jsonFile = vm["json"].as<std::string>();
-  //  else
-  //    throw std::runtime_error("Error. SST requires a json file.");
-
-  fides::io::DataSetReader *reader = nullptr;
-  if (!jsonFile.empty())
-  {
-    if (inputEngineType == "BPFile")
-      reader = new fides::io::DataSetReader(jsonFile);
-    else if (inputEngineType == "SST")
-      reader = new fides::io::DataSetReader(jsonFile); //, fides::io::DataSetReader::DataModelInput::JSONFile, true);
-  }
-  else
-  {
-    reader = new fides::io::DataSetReader(inputFname, fides::io::DataSetReader::DataModelInput::BPFile);
-  }
-    
-  
-  std::unordered_map<std::string, std::string> paths;
-  paths["source"] = inputFname;
-
-  fides::DataSourceParams params;
-  fides::metadata::MetaData selections;
-
-  params["engine_type"] = inputEngineType;
-  reader->SetDataSourceParameters("source", params);
-
-  fides::io::DataSetAppendWriter writer(outputFname);
-  int totalNumSteps = -1;
-
-  bool isBPFile = true;
-  if (inputEngineType == "BPFile")
-  {
-    auto metaData = reader->ReadMetaData(paths);
-    isBPFile = true;
-    if (metaData.Has(fides::keys::NUMBER_OF_STEPS()))
-      totalNumSteps = metaData.Get<fides::metadata::Size>(fides::keys::NUMBER_OF_STEPS()).NumberOfItems;
-  }
-  else
-    isBPFile = false;
-
-  int step = 0;
-  while (true)
+  int sleepTime = 0;
+  if (!vm["sleep"].empty())
   {
-    if (inputEngineType == "SST") std::cout<<"SST "<<__LINE__<<std::endl;
-    if (isBPFile && step == totalNumSteps)
-      break;
-
-    //std::cout<<"step= "<<step<<std::endl;
-    if (isBPFile)
-    {
-      selections.Set(fides::keys::STEP_SELECTION(), fides::metadata::Index(step));
-    }
-    else
-    {
-      if (inputEngineType == "SST") std::cout<<"SST "<<__LINE__<<std::endl;
-      auto status = reader->PrepareNextStep(paths);
-      if (status == fides::StepStatus::NotReady)
-	{
-	  std::cout << "Not ready...." << std::endl;
-	  continue;
-	}
-      else if (status == fides::StepStatus::EndOfStream)
-	{
-	  std::cout << "Stream is done" << std::endl;
-	  break;
-	}
-      if (inputEngineType == "SST") std::cout<<"SST "<<__LINE__<<std::endl;
-    }
-
-    if (inputEngineType == "SST") std::cout<<"SST "<<__LINE__<<std::endl;
-
-    vtkm::cont::PartitionedDataSet input;
-
-    if (inputEngineType == "SST") std::cout<<"SST "<<__LINE__<<std::endl;
-    if (inputEngineType == "BPFile")
-    {
-      input = reader->ReadDataSet(paths, selections);
-    }
-    else
-    {
-      if (inputEngineType == "SST") std::cout<<"SST "<<__LINE__<<std::endl;
-      input = reader->ReadDataSet(paths, selections);
-      if (inputEngineType == "SST") std::cout<<"SST "<<__LINE__<<std::endl;
-    }
-      
-
-    
-    if (inputEngineType == "SST") std::cout<<"SST "<<__LINE__<<std::endl;
-    //std::cout<<"NUMDS: "<<input.GetNumberOfPartitions()<<std::endl;
-    //auto ds = input.GetPartition(0);
-    //std::cout<<" numCS: "<<ds.GetNumberOfCoordinateSystems()<<std::endl;
-    if (inputEngineType == "SST") std::cout<<"SST "<<__LINE__<<std::endl;
-    auto output = RunService(input, vm);
-    if (inputEngineType == "SST") std::cout<<"SST "<<__LINE__<<std::endl;
-    writer.Write(output, outputEngineType); //"BPFile");
-
-    //fides::metadata::MetaData selections;
-    //selections.Set(fides::keys::BLOCK_SELECTION(), blockSelection);
-
-    //auto output = reader.ReadDataSet(paths, selections);
-    //std::cout << "Step: " << step << " #ds= " << output.GetNumberOfPartitions() << std::endl;
-    //RunService(reader, paths, writer, vm);
-
-    step++;
+    sleepTime = vm["sleep"].as<int>();
   }
-#endif
-}
 
-static void
-RunSST2(const boost::program_options::variables_map& vm)
-{
-  std::cout<<"RunSST"<<std::endl;
-  xenia::utils::DataSetWriter writer(vm);
   xenia::utils::DataSetReader reader(vm);
+  xenia::utils::DataSetWriter writer(vm);
 
-#if 0 //can we take this out??
-//old code.
-if (0)
-{
-  std::string inputFname = vm["file"].as<std::string>();
-  std::string outputFname = vm["output"].as<std::string>();
-  std::cout<<"Opening: "<<inputFname<<std::endl;
-
-  std::string jsonFile = "";
-  if (!vm["json"].empty())
-    jsonFile = vm["json"].as<std::string>();
-  else
-    throw std::runtime_error("Error. SST requires a json file.");
-
-  fides::io::DataSetReader reader(jsonFile);
-  std::unordered_map<std::string, std::string> paths;
-  paths["source"] = inputFname;
-
-  fides::DataSourceParams params;
-  params["engine_type"] = "SST";
-  reader.SetDataSourceParameters("source", params);
+  //A contour only needs the blocks whose range holds an isovalue.
+  const auto& services = GetServiceChain(vm);
+  if ((services[0] == "contour" || services[0] == "cinema") && !vm["isovals"].empty() && vm["read-all-blocks"].empty())
+  {
+    auto isoVals = vm["isovals"].as<std::vector<vtkm::FloatDefault>>();
+    reader.SetBlockValueFilter(vm["field"].as<std::string>(), std::vector<double>(isoVals.begin(), isoVals.end()));
   }
-  #endif
-
+  if (vm["read-all-fields"].empty())
+    reader.SetFieldSelection(GetInputFields(vm));
   reader.Init();
-  vtkm::Id step = 0;
-  while (true)
-  {
-    auto status = reader.BeginStep();
 
-    if (status == fides::StepStatus::NotReady)
-      continue;
-    else if (status == fides::StepStatus::EndOfStream)
-      break;
-    else if (status == fides::StepStatus::OK)
-    {
-      std::cout<<"SST read step= "<<step<<std::endl;
-      auto output = reader.Read();
-      std::cout<<"    np= "<<output.GetNumberOfPartitions()<<std::endl;
-      step++;
-    }
-    else
-      throw std::runtime_error("Unexpected status.");
-  }
+  //Before tube geometry became optional, --tube-size alone made tubes.
+  bool cylinders = (!vm["render-mode"].empty() && vm["render-mode"].as<std::string>() == "cylinder");
+  if (std::find(services.begin(), services.end(), "streamlines") != services.end() && vm["tube-geometry"].empty() &&
+      !cylinders && (!vm["tube-size"].empty() || !vm["tube-num-sides"].empty()) && reader.GetRank() == 0)
+    std::cerr<<"Warning: Streamlines are written as polylines. Add --tube-geometry to make tubes of --tube-size, "
+             <<"or render them with --render-mode cylinder."<<std::endl;
 
-  /*
+  //The converter service writes the VTK files of a rank with several threads.
+  if (std::find(services.begin(), services.end(), "converter") != services.end())
+    GetNumberOfWriteThreads(vm);
 
-  int step = 0;
-  while (true)
+  xenia::utils::StepTimer timer(vm);
+  xenia::utils::StepStream stream(reader, writer);
+  stream.SetPrefetch(vm["no-prefetch"].empty());
+  stream.SetTimer(&timer);
+  stream.SetSleepTime(sleepTime);
+
+  auto numSteps = stream.Run([&vm, &timer, &stream](vtkm::Id step, const vtkm::cont::PartitionedDataSet& input)
   {
-    auto status = reader.PrepareNextStep(paths);
-    if (status == fides::StepStatus::NotReady)
-    {
-      std::cout << "Not ready...." << std::endl;
-      continue;
-    }
-    else if (status == fides::StepStatus::EndOfStream)
-    {
-      std::cout << "Stream is done" << std::endl;
-      break;
-    }
+    std::cout<<"Step: "<<step<<std::endl;
 
-    fides::metadata::MetaData selections;
-    //selections.Set(fides::keys::BLOCK_SELECTION(), blockSelection);
+    return RunService(static_cast<int>(step), input, stream.GetBlockIDs(), vm, timer);
+  });
+  std::cout<<"Stream is done: "<<numSteps<<" steps"<<std::endl;
+  if (inputEngineType == "SST")
+    reader.GetWaitPolicy().PrintSummary(std::cout);
 
-    auto output = reader.ReadDataSet(paths, selections);
-    std::cout << "Step: " << step << " #ds= " << output.GetNumberOfPartitions() << std::endl;
-    RunService(writer, output, vm);
+  if (std::find(services.begin(), services.end(), "render") != services.end())
+    GetRenderer(vm).Finish();
+  if (std::find(services.begin(), services.end(), "cinema") != services.end())
+    GetCinemaDatabase(vm).Finish();
 
-    step++;
-  }
-  */
+  writer.Close();
+  timer.Finish();
 }
 
 int main(int argc, char** argv)
 {
 #ifdef ENABLE_MPI
-  MPI_Init(NULL, NULL);
+  //The step stream reads the next step on a separate thread.
+  int provided = MPI_THREAD_SINGLE;
+  MPI_Init_thread(NULL, NULL, MPI_THREAD_MULTIPLE, &provided);
+
+  //VTK-m filters (e.g. streamlines) communicate on their own copy of the world communicator.
+  MPI_Comm vtkmComm;
+  MPI_Comm_dup(MPI_COMM_WORLD, &vtkmComm);
+  vtkm::cont::EnvironmentTracker::SetCommunicator(vtkmdiy::mpi::communicator(vtkmdiy::mpi::make_DIY_MPI_Comm(vtkmComm)));
 #endif
 
   //InitDebug();
@@ -1052,7 +737,20 @@ int main(int argc, char** argv)
     ("output", po::value<std::string>(), "Output file")
     ("input_engine", po::value<std::string>(), "Adios2 input engine type (BP, SST, or VTK)")
     ("output_engine", po::value<std::string>(), "Adios2 output engine type (BP or SST)")
-    ("service", po::value<std::string>(), "Type of service to run (copier, streamline, contour, render)")
+    ("service", po::value<std::string>(), "Type of service to run (copier, streamline, contour, render, cinema). A comma separated list runs the services in order, e.g. contour,render")
+    ("no-prefetch", "Do not read the next step while the current step is processed")
+    ("roi", po::value<std::vector<double>>()->multitoken(), "Region of interest `xmin xmax ymin ymax zmin zmax`. Only the blocks that overlap it are read (BP files), and uniform and rectilinear blocks are cut down to it")
+    ("steps", po::value<std::string>(), "Steps to read as start:stop:stride, e.g. ::10 for every 10th step (default all)")
+    ("output-steps", po::value<std::string>(), "Steps to write as start:stop:stride (default all). With SST output the other steps are not sent")
+    ("step-timeout", po::value<double>(), "Seconds to wait for the next SST step before giving up (default waits forever)")
+    ("step-backoff-max", po::value<double>(), "Longest sleep in seconds between checks for the next SST step (default 1)")
+    ("timing", po::value<std::string>(), "Write per step, per rank stage timings to a .csv or .json file")
+    ("timing-summary", "Print the min/max/avg stage times over all ranks")
+    ("block-weight", po::value<std::string>(), "Balance blocks over ranks by number of points or cells (points, cells)")
+    ("rebalance-interval", po::value<vtkm::Id>(), "Every N steps, rebalance blocks over ranks using the measured cost of each block")
+    ("vtk-ascii", "Write ASCII instead of binary VTK files")
+    ("vtk-compress", "Compress the arrays of VTK XML (.pvd) output with zlib")
+    ("write-threads", po::value<int>(), "Threads used to write the VTK files of a rank (default is the cores on the node divided over the ranks on the node)")
     ;
 
     //converter
@@ -1060,9 +758,12 @@ int main(int argc, char** argv)
 
     //contour
     desc.add_options()
-      ("cell_to_point", "Average cell field to point")
+      ("cell_to_point", "Average the needed cell fields to the points. The point field of cell field X is X_point (e.g. --field energy_point)")
       ("field", po::value<std::string>(), "field name in input data")
+      ("pass-fields", po::value<std::vector<std::string>>()->multitoken(), "Fields kept on the contour besides --field and --render-field (default all, or none with --cell_to_point)")
       ("isovals", po::value<std::vector<vtkm::FloatDefault>>(), "Isosurface values")
+      ("read-all-blocks", "Read every block, not only the blocks whose min/max holds an isovalue (BP files)")
+      ("read-all-fields", "Read every field, not only the fields the service uses (--field, --fieldx/y/z, --render-field, --pass-fields)")
       ;
 
     //streamline
@@ -1075,8 +776,16 @@ int main(int argc, char** argv)
     ("seed-grid-dims", po::value<std::string>(), "Specify the number of seed points in each dimension of the seed grid. The values are specified as `numx numy numz`.")
     ("step-size", po::value<vtkm::FloatDefault>(), "Step size for particle advection.")
     ("max-steps", po::value<vtkm::Id>(), "Maximum number of steps.")
-    ("tube-size", po::value<vtkm::FloatDefault>(), "If specified, create tube geometry with the given radius.")
-    ("tube-num-sides", po::value<vtkm::IdComponent>(), "Number of sides around tubes (if generated).");
+    ("tube-size", po::value<vtkm::FloatDefault>(), "Tube radius, for --tube-geometry and --render-mode cylinder.")
+    ("tube-geometry", "Turn the streamlines into tube geometry of radius --tube-size. Without it the streamlines stay polylines.")
+    ("tube-num-sides", po::value<vtkm::IdComponent>(), "Number of sides around tubes (if generated).")
+    ("streamline-threads", "Advect particles on a worker thread while MPI messages are handled on another.")
+    ("streamline-async", "Exchange particles between ranks with asynchronous messages (VTK-m 2.1 and later).")
+    ("streamline-attributes", "Add SeedID (LineIndex for --integrator rk4), ArcLength, Time and Speed point fields to the streamlines.")
+    ("integrator", po::value<std::string>(), "Particle integrator: rk4 (fixed --step-size, default) or rk45 (adaptive, starts at --step-size, does not cross ranks).")
+    ("tolerance", po::value<vtkm::FloatDefault>(), "rk45: largest position error accepted in one step (default 1e-5).")
+    ("min-step-size", po::value<vtkm::FloatDefault>(), "rk45: smallest step size (default --step-size / 100).")
+    ("max-step-size", po::value<vtkm::FloatDefault>(), "rk45: largest step size (default --step-size * 100).");
 
     //render
     desc.add_options()
@@ -1086,7 +795,23 @@ int main(int argc, char** argv)
     ("fov", po::value<float>(), "Camera up direction")
     ("clip", po::value<std::vector<float>>()->multitoken(), "Clipping range")
     ("imagesize", po::value<std::vector<int>>()->multitoken(), "Image size")
-    ("scalar_range", po::value<std::vector<float>>()->multitoken(), "Scalar rendering range");
+    ("scalar_range", po::value<std::vector<float>>()->multitoken(), "Scalar rendering range")
+    ("scalar-range-mode", po::value<std::string>(), "How the scalar rendering range is found: fixed (default, --scalar_range), auto (each step), grow, smooth or freeze (first step)")
+    ("scalar-range-smoothing", po::value<double>(), "Weight of the newest step for --scalar-range-mode smooth (default 0.25)")
+    ("render-field", po::value<std::string>(), "Field to color by when rendering (default is --field)")
+    ("color-table", po::value<std::string>(), "Color table used when rendering (default is Cool to Warm)")
+    ("render-mode", po::value<std::string>(), "surface (default) ray traces the cells, volume renders uniform or rectilinear grids directly, cylinder draws lines as cylinders of radius --tube-size")
+    ("sample-distance", po::value<float>(), "Distance between samples along each ray for volume rendering")
+    ("opacity-points", po::value<std::vector<float>>()->multitoken(), "Volume rendering opacity as pairs of position in [0,1] of the scalar range and opacity (default 0 0 1 1)")
+    ("encode-threads", po::value<int>(), "Threads that encode and write PNG images in the background (default 2, 0 writes them on the render thread)")
+    ("encode-queue", po::value<int>(), "Most rendered images waiting to be written before rendering waits (default 4)");
+
+    //cinema
+    desc.add_options()
+      ("cinema-db", po::value<std::string>(), "Directory of the cinema image database (e.g. out.cdb)")
+      ("camera-orbit", po::value<std::vector<int>>()->multitoken(), "Cameras on rings around --lookat: number around and number of rings up")
+      ("camera-positions", po::value<std::vector<float>>()->multitoken(), "Camera positions (x y z for each camera), all looking at --lookat")
+      ("cinema-depth", "Also write the depth buffer of each cinema image");
 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -8,6 +8,9 @@
 #include <fides/DataSetReader.h>
 #include <fides/DataSetWriter.h>
 
+#include <vtkm/cont/EnvironmentTracker.h>
+#include <vtkm/thirdparty/diy/diy.h>
+#include <vtkm/thirdparty/diy/mpi-cast.h>
 #include <vtkm/filter/field_transform/CompositeVectors.h>
 #include <vtkm/filter/flow/Streamline.h>
 #include <vtkm/filter/geometry_refinement/Tube.h>
@@ -205,16 +208,12 @@ RunSST(const boost::program_options::variables_map& vm)
   params["engine_type"] = "SST";
   reader.SetDataSourceParameters("source", params);
 
+  xenia::utils::StepWaitPolicy waitPolicy(vm);
   int step = 0;
   while (true)
   {
-    auto status = reader.PrepareNextStep(paths);
-    if (status == fides::StepStatus::NotReady)
-    {
-      std::cout << "Not ready...." << std::endl;
-      continue;
-    }
-    else if (status == fides::StepStatus::EndOfStream)
+    auto status = waitPolicy.Wait([&reader, &paths]() { return reader.PrepareNextStep(paths); });
+    if (status == fides::StepStatus::EndOfStream)
     {
       std::cout << "Stream is done" << std::endl;
       break;
@@ -233,6 +232,8 @@ RunSST(const boost::program_options::variables_map& vm)
 int main(int argc, char** argv)
 {
   MPI_Init(NULL, NULL);
+  //Particles are exchanged between ranks on this communicator.
+  vtkm::cont::EnvironmentTracker::SetCommunicator(vtkmdiy::mpi::communicator(vtkmdiy::mpi::make_DIY_MPI_Comm(MPI_COMM_WORLD)));
 
   namespace po = boost::program_options;
   po::options_description desc("Allowed options");
@@ -255,6 +256,8 @@ int main(int argc, char** argv)
     ("tube-num-sides", po::value<vtkm::IdComponent>(), "Number of sides around tubes (if generated).")
     ("input_engine", po::value<std::string>(), "Adios2 input engine type (BP or SST)")
     ("output_engine", po::value<std::string>(), "Adios2 output engine type (BP or SST)")
+    ("step-timeout", po::value<double>(), "Seconds to wait for the next SST step before giving up (default waits forever)")
+    ("step-backoff-max", po::value<double>(), "Longest sleep in seconds between checks for the next SST step (default 1)")
     ;
 
   po::variables_map vm;
@@ -0,0 +1,96 @@
+#include "BlockMetaData.h"
+
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+
+namespace xenia
+{
+namespace utils
+{
+
+#define xeniaADIOSTypeMacro(TYPE, call)                                                   \
+  {                                                                                       \
+    if (TYPE == "float") { using VAR_TYPE = float; call; }                                \
+    else if (TYPE == "double") { using VAR_TYPE = double; call; }                         \
+    else if (TYPE == "int8_t") { using VAR_TYPE = int8_t; call; }                         \
+    else if (TYPE == "uint8_t") { using VAR_TYPE = uint8_t; call; }                       \
+    else if (TYPE == "int16_t") { using VAR_TYPE = int16_t; call; }                       \
+    else if (TYPE == "uint16_t") { using VAR_TYPE = uint16_t; call; }                     \
+    else if (TYPE == "int32_t") { using VAR_TYPE = int32_t; call; }                       \
+    else if (TYPE == "uint32_t") { using VAR_TYPE = uint32_t; call; }                     \
+    else if (TYPE == "int64_t") { using VAR_TYPE = int64_t; call; }                       \
+    else if (TYPE == "uint64_t") { using VAR_TYPE = uint64_t; call; }                     \
+    else if (TYPE == "char") { using VAR_TYPE = char; call; }                             \
+    else { throw std::runtime_error("Unsupported variable type: " + TYPE); }             \
+  }
+
+template <typename T>
+static void
+GetBlockSizesImpl(adios2::IO& io,
+                  adios2::Engine& engine,
+                  const std::string& varName,
+                  std::size_t step,
+                  std::vector<std::size_t>& sizes)
+{
+  auto var = io.InquireVariable<T>(varName);
+  for (const auto& info : engine.BlocksInfo(var, step))
+  {
+    std::size_t n = std::accumulate(info.Count.begin(), info.Count.end(), std::size_t(1), std::multiplies<std::size_t>());
+    sizes.push_back(n);
+  }
+}
+
+template <typename T>
+static void
+GetBlockRangesImpl(adios2::IO& io,
+                   adios2::Engine& engine,
+                   const std::string& varName,
+                   std::size_t step,
+                   std::vector<std::pair<double, double>>& ranges)
+{
+  auto var = io.InquireVariable<T>(varName);
+  for (const auto& info : engine.BlocksInfo(var, step))
+    ranges.push_back({ static_cast<double>(info.Min), static_cast<double>(info.Max) });
+}
+
+BlockMetaData::BlockMetaData(const std::string& fileName)
+{
+  this->IO = this->Adios.DeclareIO("xenia-block-metadata");
+  this->Engine = this->IO.Open(fileName, adios2::Mode::ReadRandomAccess);
+}
+
+BlockMetaData::~BlockMetaData()
+{
+  if (this->Engine)
+    this->Engine.Close();
+}
+
+bool
+BlockMetaData::HasVariable(const std::string& varName) const
+{
+  return !this->IO.VariableType(varName).empty();
+}
+
+std::vector<std::size_t>
+BlockMetaData::GetBlockSizes(const std::string& varName, std::size_t step) const
+{
+  std::vector<std::size_t> sizes;
+  auto varType = this->IO.VariableType(varName);
+  xeniaADIOSTypeMacro(varType, GetBlockSizesImpl<VAR_TYPE>(this->IO, this->Engine, varName, step, sizes));
+
+  return sizes;
+}
+
+std::vector<std::pair<double, double>>
+BlockMetaData::GetBlockRanges(const std::string& varName, std::size_t step) const
+{
+  std::vector<std::pair<double, double>> ranges;
+  auto varType = this->IO.VariableType(varName);
+  xeniaADIOSTypeMacro(varType, GetBlockRangesImpl<VAR_TYPE>(this->IO, this->Engine, varName, step, ranges));
+
+  return ranges;
+}
+
+}
+} //xenia::utils
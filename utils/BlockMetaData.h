@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <adios2.h>
+
+namespace xenia
+{
+namespace utils
+{
+
+// Per-block information stored in the metadata of an ADIOS BP file.
+// This is read without reading any of the data, so it can be used to decide which blocks to read.
+class BlockMetaData
+{
+  public:
+  BlockMetaData(const std::string& fileName);
+  ~BlockMetaData();
+
+  bool HasVariable(const std::string& varName) const;
+
+  //Number of values in each block of varName.
+  std::vector<std::size_t> GetBlockSizes(const std::string& varName, std::size_t step) const;
+
+  //Min and max of varName in each block.
+  std::vector<std::pair<double, double>> GetBlockRanges(const std::string& varName, std::size_t step) const;
+
+  private:
+  adios2::ADIOS Adios;
+  mutable adios2::IO IO;
+  mutable adios2::Engine Engine;
+};
+
+}
+} //xenia::utils
@@ -0,0 +1,146 @@
+#include "Cinema.h"
+
+#include <cerrno>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace xenia
+{
+namespace utils
+{
+
+CinemaDatabase::CinemaDatabase(const boost::program_options::variables_map& vm)
+  : ImageRenderer(vm)
+{
+#ifdef ENABLE_MPI
+  MPI_Comm_rank(MPI_COMM_WORLD, &this->Rank);
+#endif
+
+  if (vm["cinema-db"].empty())
+    throw std::runtime_error("Error. The cinema service needs --cinema-db.");
+  if (vm["render-field"].empty() && vm["field"].empty())
+    throw std::runtime_error("Error. The cinema service needs --field or --render-field.");
+  this->DirName = vm["cinema-db"].as<std::string>();
+  this->WriteDepth = (vm.count("cinema-depth") > 0);
+  this->HasIsoValues = !vm["isovals"].empty();
+
+  //The camera set.
+  auto baseCamera = MakeCamera(vm);
+  if (!vm["camera-orbit"].empty())
+  {
+    const auto& vals = vm["camera-orbit"].as<std::vector<int>>();
+    if (vals.size() != 2 || vals[0] < 1 || vals[1] < 1)
+      throw std::runtime_error("Error. --camera-orbit needs the number of cameras around and up (e.g. 8 3).");
+
+    //phi goes around the look at point, theta goes from below to above it, skipping the poles.
+    this->Orbit = true;
+    for (int j = 0; j < vals[1]; j++)
+    {
+      vtkm::Float64 theta = -90.0 + 180.0 * (j + 1) / (vals[1] + 1);
+      for (int i = 0; i < vals[0]; i++)
+      {
+        vtkm::Float64 phi = 360.0 * i / vals[0];
+        auto camera = baseCamera;
+        camera.Azimuth(static_cast<vtkm::Float32>(phi));
+        camera.Elevation(static_cast<vtkm::Float32>(theta));
+        this->Cameras.push_back({camera, phi, theta});
+      }
+    }
+  }
+  else if (!vm["camera-positions"].empty())
+  {
+    const auto& vals = vm["camera-positions"].as<std::vector<float>>();
+    if (vals.empty() || vals.size() % 3 != 0)
+      throw std::runtime_error("Error. --camera-positions needs x y z for each camera.");
+    for (std::size_t i = 0; i < vals.size(); i += 3)
+    {
+      auto camera = baseCamera;
+      camera.SetPosition(vtkm::Vec3f_32(vals[i], vals[i+1], vals[i+2]));
+      this->Cameras.push_back({camera, 0.0, 0.0});
+    }
+  }
+  else
+    this->Cameras.push_back({baseCamera, 0.0, 0.0});
+
+  if (this->Rank != 0)
+    return;
+
+  if (mkdir(this->DirName.c_str(), 0755) != 0 && errno != EEXIST)
+    throw std::runtime_error("Error. Cannot create cinema database: " + this->DirName);
+
+  this->Index.open(this->DirName + "/data.csv");
+  this->Index<<"time";
+  if (this->HasIsoValues)
+    this->Index<<",isovalue";
+  this->Index<<",camera";
+  if (this->Orbit)
+    this->Index<<",phi,theta";
+  this->Index<<",FILE";
+  if (this->WriteDepth)
+    this->Index<<",FILE_depth";
+  this->Index<<std::endl;
+}
+
+void
+CinemaDatabase::Render(vtkm::Id step, const vtkm::cont::PartitionedDataSet& pds)
+{
+  this->RenderViews(step, pds, "", "");
+}
+
+void
+CinemaDatabase::Render(vtkm::Id step, const vtkm::cont::PartitionedDataSet& pds, std::size_t isoIndex, vtkm::FloatDefault isoValue)
+{
+  std::ostringstream isoColumn;
+  isoColumn<<isoValue;
+  this->RenderViews(step, pds, "_iso_" + std::to_string(isoIndex), isoColumn.str());
+}
+
+void
+CinemaDatabase::Finish()
+{
+  this->ImageRenderer.Finish();
+}
+
+void
+CinemaDatabase::RenderViews(vtkm::Id step,
+                            const vtkm::cont::PartitionedDataSet& pds,
+                            const std::string& isoLabel,
+                            const std::string& isoColumn)
+{
+  //The actors (and their scalar range) are the same for every camera.
+  this->ImageRenderer.SetData(pds);
+
+  std::vector<vtkm::Float32> colors, depths;
+  for (std::size_t c = 0; c < this->Cameras.size(); c++)
+  {
+    this->ImageRenderer.SetCamera(this->Cameras[c].Camera);
+    if (!this->ImageRenderer.RenderImage(colors, depths))
+      continue;
+
+    std::string baseName = "ts_" + std::to_string(step) + isoLabel + "_cam_" + std::to_string(c);
+    if (this->WriteDepth)
+    {
+      std::ofstream fout(this->DirName + "/" + baseName + ".depth.raw", std::ios::binary);
+      fout.write(reinterpret_cast<const char*>(depths.data()), static_cast<std::streamsize>(depths.size() * sizeof(vtkm::Float32)));
+    }
+    this->ImageRenderer.SaveImage(this->DirName + "/" + baseName + ".png", std::move(colors), depths);
+
+    this->Index<<step;
+    if (this->HasIsoValues)
+      this->Index<<","<<isoColumn;
+    this->Index<<","<<c;
+    if (this->Orbit)
+      this->Index<<","<<this->Cameras[c].Phi<<","<<this->Cameras[c].Theta;
+    this->Index<<","<<baseName<<".png";
+    if (this->WriteDepth)
+      this->Index<<","<<baseName<<".depth.raw";
+    this->Index<<std::endl;
+  }
+  if (this->Rank == 0)
+    std::cout<<"Cinema step: "<<step<<isoLabel<<" "<<this->Cameras.size()<<" cameras"<<std::endl;
+}
+
+}
+} //xenia::utils
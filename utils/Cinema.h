@@ -0,0 +1,57 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <vtkm/cont/PartitionedDataSet.h>
+#include <vtkm/rendering/Camera.h>
+#include <boost/program_options.hpp>
+
+#include "Render.h"
+
+namespace xenia
+{
+namespace utils
+{
+
+// Cinema (spec D) image database. Each step is rendered from every camera in a camera set, once for each
+// isovalue when contours are rendered. The scene is built once per step and isovalue and reused for all cameras.
+//  --cinema-db name.cdb                 directory of the database. The images are indexed in name.cdb/data.csv.
+//  --camera-orbit nphi ntheta           cameras on rings around --lookat, at the distance of --position.
+//  --camera-positions x y z [x y z...]  camera positions, all looking at --lookat.
+//  --cinema-depth                       also write the depth buffer of each image as raw float32 values.
+class CinemaDatabase
+{
+  public:
+  CinemaDatabase(const boost::program_options::variables_map& vm);
+
+  void Render(vtkm::Id step, const vtkm::cont::PartitionedDataSet& pds);
+  //Render the contour for isoValues[isoIndex].
+  void Render(vtkm::Id step, const vtkm::cont::PartitionedDataSet& pds, std::size_t isoIndex, vtkm::FloatDefault isoValue);
+
+  //Wait until every image is written.
+  void Finish();
+
+  private:
+  struct CameraView
+  {
+    vtkm::rendering::Camera Camera;
+    vtkm::Float64 Phi;
+    vtkm::Float64 Theta;
+  };
+
+  void RenderViews(vtkm::Id step, const vtkm::cont::PartitionedDataSet& pds, const std::string& isoLabel, const std::string& isoColumn);
+
+  Renderer ImageRenderer;
+  std::vector<CameraView> Cameras;
+  std::string DirName;
+  std::ofstream Index;
+  bool Orbit = false;
+  bool HasIsoValues = false;
+  bool WriteDepth = false;
+  int Rank = 0;
+};
+
+}
+} //xenia::utils
@@ -0,0 +1,177 @@
+#include "Compositor.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace xenia
+{
+namespace utils
+{
+
+//Keep the closer of the two fragments for each pixel.
+static void
+DepthComposite(vtkm::Float32* colors,
+               vtkm::Float32* depths,
+               const vtkm::Float32* inColors,
+               const vtkm::Float32* inDepths,
+               std::size_t numPixels)
+{
+  for (std::size_t i = 0; i < numPixels; i++)
+  {
+    if (inDepths[i] < depths[i])
+    {
+      depths[i] = inDepths[i];
+      for (std::size_t c = 0; c < 4; c++)
+        colors[4*i + c] = inColors[4*i + c];
+    }
+  }
+}
+
+//Blend colors (behind) under accum (in front). Both are premultiplied.
+static void
+BlendUnder(vtkm::Float32* accum, const vtkm::Float32* colors, std::size_t numPixels)
+{
+  for (std::size_t i = 0; i < numPixels; i++)
+  {
+    vtkm::Float32 transmission = 1.0f - accum[4*i + 3];
+    for (std::size_t c = 0; c < 4; c++)
+      accum[4*i + c] += transmission * colors[4*i + c];
+  }
+}
+
+ImageCompositor::ImageCompositor()
+{
+#ifdef ENABLE_MPI
+  MPI_Comm_rank(MPI_COMM_WORLD, &this->Rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &this->NumRanks);
+#endif
+}
+
+void
+ImageCompositor::Composite(std::vector<vtkm::Float32>& colors, std::vector<vtkm::Float32>& depths) const
+{
+#ifdef ENABLE_MPI
+  if (this->NumRanks == 1)
+    return;
+
+  const int colorTag = 200, depthTag = 201;
+  std::size_t numPixels = depths.size();
+  std::vector<vtkm::Float32> inColors, inDepths;
+
+  int pof2 = 1;
+  while (pof2 * 2 <= this->NumRanks)
+    pof2 *= 2;
+
+  //Fold the ranks beyond the largest power of two onto the first ranks.
+  if (this->Rank >= pof2)
+  {
+    int partner = this->Rank - pof2;
+    MPI_Send(colors.data(), static_cast<int>(4*numPixels), MPI_FLOAT, partner, colorTag, MPI_COMM_WORLD);
+    MPI_Send(depths.data(), static_cast<int>(numPixels), MPI_FLOAT, partner, depthTag, MPI_COMM_WORLD);
+  }
+  else if (this->Rank + pof2 < this->NumRanks)
+  {
+    int partner = this->Rank + pof2;
+    inColors.resize(4*numPixels);
+    inDepths.resize(numPixels);
+    MPI_Recv(inColors.data(), static_cast<int>(4*numPixels), MPI_FLOAT, partner, colorTag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Recv(inDepths.data(), static_cast<int>(numPixels), MPI_FLOAT, partner, depthTag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    DepthComposite(colors.data(), depths.data(), inColors.data(), inDepths.data(), numPixels);
+  }
+
+  //Binary swap. [begin, end) is the part of the image this rank owns.
+  std::size_t begin = 0, end = (this->Rank < pof2 ? numPixels : 0);
+  for (int bit = 1; bit < pof2 && this->Rank < pof2; bit <<= 1)
+  {
+    int partner = this->Rank ^ bit;
+    std::size_t mid = begin + (end - begin) / 2;
+    bool keepLow = ((this->Rank & bit) == 0);
+    std::size_t keep0 = (keepLow ? begin : mid), keep1 = (keepLow ? mid : end);
+    std::size_t send0 = (keepLow ? mid : begin), send1 = (keepLow ? end : mid);
+    std::size_t numKeep = keep1 - keep0, numSend = send1 - send0;
+
+    inColors.resize(4*numKeep);
+    inDepths.resize(numKeep);
+    MPI_Sendrecv(colors.data() + 4*send0, static_cast<int>(4*numSend), MPI_FLOAT, partner, colorTag,
+                 inColors.data(), static_cast<int>(4*numKeep), MPI_FLOAT, partner, colorTag,
+                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(depths.data() + send0, static_cast<int>(numSend), MPI_FLOAT, partner, depthTag,
+                 inDepths.data(), static_cast<int>(numKeep), MPI_FLOAT, partner, depthTag,
+                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    DepthComposite(colors.data() + 4*keep0, depths.data() + keep0, inColors.data(), inDepths.data(), numKeep);
+
+    begin = keep0;
+    end = keep1;
+  }
+
+  //Gather the finished parts into place on rank 0.
+  int part[2] = { static_cast<int>(begin), static_cast<int>(end - begin) };
+  std::vector<int> parts(2 * this->NumRanks);
+  MPI_Gather(part, 2, MPI_INT, parts.data(), 2, MPI_INT, 0, MPI_COMM_WORLD);
+
+  if (this->Rank == 0)
+  {
+    std::vector<int> colorCounts(this->NumRanks), colorDispls(this->NumRanks);
+    std::vector<int> depthCounts(this->NumRanks), depthDispls(this->NumRanks);
+    for (int i = 0; i < this->NumRanks; i++)
+    {
+      depthDispls[i] = parts[2*i];
+      depthCounts[i] = parts[2*i+1];
+      colorDispls[i] = 4 * depthDispls[i];
+      colorCounts[i] = 4 * depthCounts[i];
+    }
+    MPI_Gatherv(MPI_IN_PLACE, 0, MPI_FLOAT, colors.data(), colorCounts.data(), colorDispls.data(), MPI_FLOAT, 0, MPI_COMM_WORLD);
+    MPI_Gatherv(MPI_IN_PLACE, 0, MPI_FLOAT, depths.data(), depthCounts.data(), depthDispls.data(), MPI_FLOAT, 0, MPI_COMM_WORLD);
+  }
+  else
+  {
+    MPI_Gatherv(colors.data() + 4*begin, 4*part[1], MPI_FLOAT, nullptr, nullptr, nullptr, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    MPI_Gatherv(depths.data() + begin, part[1], MPI_FLOAT, nullptr, nullptr, nullptr, MPI_FLOAT, 0, MPI_COMM_WORLD);
+  }
+#else
+  (void)colors;
+  (void)depths;
+#endif
+}
+
+void
+ImageCompositor::CompositeOrdered(std::vector<vtkm::Float32>& colors, vtkm::Float32 visibilityKey) const
+{
+#ifdef ENABLE_MPI
+  if (this->NumRanks == 1)
+    return;
+
+  const int colorTag = 202;
+  std::vector<vtkm::Float32> keys(this->NumRanks);
+  MPI_Gather(&visibilityKey, 1, MPI_FLOAT, keys.data(), 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
+
+  if (this->Rank != 0)
+  {
+    MPI_Send(colors.data(), static_cast<int>(colors.size()), MPI_FLOAT, 0, colorTag, MPI_COMM_WORLD);
+    return;
+  }
+
+  std::vector<int> order(this->NumRanks);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+
+  std::vector<vtkm::Float32> accum(colors.size(), 0.0f), inColors(colors.size());
+  for (int rank : order)
+  {
+    if (rank == 0)
+      BlendUnder(accum.data(), colors.data(), colors.size() / 4);
+    else
+    {
+      MPI_Recv(inColors.data(), static_cast<int>(inColors.size()), MPI_FLOAT, rank, colorTag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      BlendUnder(accum.data(), inColors.data(), inColors.size() / 4);
+    }
+  }
+  colors.swap(accum);
+#else
+  (void)colors;
+  (void)visibilityKey;
+#endif
+}
+
+}
+} //xenia::utils
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include <vtkm/Types.h>
+
+#ifdef ENABLE_MPI
+#include <mpi.h>
+#endif
+
+namespace xenia
+{
+namespace utils
+{
+
+// Sort-last compositing of the images rendered by each rank.
+// Every rank renders its own blocks with the same camera. The images are combined by depth with binary swap:
+// ranks beyond the largest power of two first send their image to a partner, then in each round a rank keeps
+// half of the part of the image it owns and exchanges the other half with a partner.
+// The finished parts are gathered on rank 0.
+// Semi-transparent images are instead sent to rank 0 and blended in visibility order.
+class ImageCompositor
+{
+  public:
+  ImageCompositor();
+
+  //colors are RGBA, depths are one value per pixel. Collective.
+  //On return, rank 0 holds the composited image. The buffers on other ranks are undefined.
+  void Composite(std::vector<vtkm::Float32>& colors, std::vector<vtkm::Float32>& depths) const;
+
+  //For semi-transparent images (volume rendering), where depth does not decide the result.
+  //colors are premultiplied RGBA. The images are blended front to back on rank 0 in the order of
+  //visibilityKey (smallest is closest to the camera). Collective.
+  void CompositeOrdered(std::vector<vtkm::Float32>& colors, vtkm::Float32 visibilityKey) const;
+
+  int GetRank() const { return this->Rank; }
+  int GetNumberOfRanks() const { return this->NumRanks; }
+
+  private:
+  int Rank = 0;
+  int NumRanks = 1;
+};
+
+}
+} //xenia::utils
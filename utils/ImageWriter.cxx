@@ -0,0 +1,128 @@
+#include "ImageWriter.h"
+
+#include <vtkm/io/EncodePNG.h>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace xenia
+{
+namespace utils
+{
+
+AsyncImageWriter::AsyncImageWriter(int numThreads, std::size_t queueSize)
+  : QueueSize(std::max(queueSize, std::size_t(1)))
+{
+  for (int i = 0; i < std::max(numThreads, 1); i++)
+    this->Threads.emplace_back(&AsyncImageWriter::Work, this);
+}
+
+AsyncImageWriter::~AsyncImageWriter()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Done = true;
+  }
+  this->QueueChanged.notify_all();
+
+  //Images still in the queue are written before the threads exit.
+  for (auto& thread : this->Threads)
+    thread.join();
+
+  if (this->Error)
+  {
+    try
+    {
+      std::rethrow_exception(this->Error);
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr<<"Error writing image: "<<e.what()<<std::endl;
+    }
+  }
+}
+
+void
+AsyncImageWriter::Push(const std::string& fileName, vtkm::Id width, vtkm::Id height, std::vector<vtkm::Float32>&& colors)
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  this->QueueChanged.wait(lock, [this]() { return this->Queue.size() < this->QueueSize || this->Error; });
+  if (this->Error)
+    std::rethrow_exception(this->Error);
+
+  this->Queue.push_back({fileName, width, height, std::move(colors)});
+  lock.unlock();
+  this->QueueChanged.notify_all();
+}
+
+void
+AsyncImageWriter::Finish()
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  this->QueueChanged.wait(lock, [this]() { return this->Queue.empty() && this->NumBusy == 0; });
+  if (this->Error)
+  {
+    auto error = this->Error;
+    this->Error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void
+AsyncImageWriter::Work()
+{
+  while (true)
+  {
+    Image image;
+    {
+      std::unique_lock<std::mutex> lock(this->Mutex);
+      this->QueueChanged.wait(lock, [this]() { return this->Done || !this->Queue.empty(); });
+      if (this->Queue.empty())
+        return;
+
+      image = std::move(this->Queue.front());
+      this->Queue.pop_front();
+      this->NumBusy++;
+    }
+    this->QueueChanged.notify_all();
+
+    try
+    {
+      AsyncImageWriter::WriteImage(image);
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      if (!this->Error)
+        this->Error = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->NumBusy--;
+    }
+    this->QueueChanged.notify_all();
+  }
+}
+
+void
+AsyncImageWriter::WriteImage(const Image& image)
+{
+  //PNG rows start at the top.
+  std::vector<unsigned char> pixels(static_cast<std::size_t>(4 * image.Width * image.Height));
+  for (vtkm::Id y = 0; y < image.Height; y++)
+  {
+    const vtkm::Float32* src = image.Colors.data() + 4 * (image.Height - 1 - y) * image.Width;
+    unsigned char* dst = pixels.data() + 4 * y * image.Width;
+    for (vtkm::Id i = 0; i < 4 * image.Width; i++)
+      dst[i] = static_cast<unsigned char>(std::min(std::max(src[i], 0.0f), 1.0f) * 255.0f);
+  }
+
+  auto err = vtkm::io::SavePNG(image.FileName, pixels, static_cast<unsigned long>(image.Width), static_cast<unsigned long>(image.Height));
+  if (err != 0)
+    throw std::runtime_error("Error. Failed to write PNG file: " + image.FileName);
+}
+
+}
+} //xenia::utils
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vtkm/Types.h>
+
+namespace xenia
+{
+namespace utils
+{
+
+// Encodes and writes PNG images on background threads so rendering can go on with the next step.
+// Several images are encoded at once when there is more than one thread.
+// At most QueueSize images wait to be written. Push blocks when the queue is full.
+class AsyncImageWriter
+{
+  public:
+  AsyncImageWriter(int numThreads, std::size_t queueSize);
+  ~AsyncImageWriter();
+
+  //colors are RGBA values in [0,1], bottom row first, as stored in a vtkm canvas.
+  void Push(const std::string& fileName, vtkm::Id width, vtkm::Id height, std::vector<vtkm::Float32>&& colors);
+
+  //Wait until every image is written. Rethrows the first error from a writer thread.
+  void Finish();
+
+  private:
+  struct Image
+  {
+    std::string FileName;
+    vtkm::Id Width;
+    vtkm::Id Height;
+    std::vector<vtkm::Float32> Colors;
+  };
+
+  void Work();
+  static void WriteImage(const Image& image);
+
+  std::deque<Image> Queue;
+  std::size_t QueueSize;
+  std::size_t NumBusy = 0;
+  bool Done = false;
+  std::exception_ptr Error;
+  std::mutex Mutex;
+  std::condition_variable QueueChanged;
+  std::vector<std::thread> Threads;
+};
+
+}
+} //xenia::utils
@@ -1,8 +1,21 @@
 #include "ReadData.h"
+#include "BlockMetaData.h"
 #include "CommandLineArgParser.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+#include <vtkm/RangeId3.h>
+#include <vtkm/cont/ArrayHandleCartesianProduct.h>
+#include <vtkm/cont/ArrayHandleUniformPointCoordinates.h>
+#include <vtkm/cont/CellSetStructured.h>
+#include <vtkm/cont/DataSet.h>
+#include <vtkm/cont/Field.h>
 #include <vtkm/cont/PartitionedDataSet.h>
 #include <vtkm/io/VTKDataSetReader.h>
+#include <vtkm/filter/entity_extraction/ExtractStructured.h>
 #include <vtkm/filter/entity_extraction/GhostCellRemove.h>
 
 #include <fides/DataSetReader.h>
@@ -15,10 +28,13 @@ namespace utils
 const std::set<std::string> DataSetReader::ValidEngineTypes({"BPFile", "SST"});
 
 DataSetReader::DataSetReader(const boost::program_options::variables_map& vm)
+  : WaitPolicy(vm)
+  , Steps(vm, "steps")
 {
 #ifdef ENABLE_MPI
   MPI_Comm_rank(MPI_COMM_WORLD, &this->Rank);
   MPI_Comm_size(MPI_COMM_WORLD, &this->NumRanks);
+  MPI_Comm_dup(MPI_COMM_WORLD, &this->Comm);
 #endif
 
   std::cout<<"building dataset reader."<<std::endl;
@@ -65,57 +81,340 @@ DataSetReader::DataSetReader(const boost::program_options::variables_map& vm)
     this->GhostCellFieldName = vm["remove-ghost-cells"].as<std::string>();
     std::cout<<"Removing ghost cells: "<<this->GhostCellFieldName<<std::endl;
   }
+
+  if (!vm["block-weight"].empty())
+  {
+    this->BlockWeight = vm["block-weight"].as<std::string>();
+    if (this->BlockWeight != "points" && this->BlockWeight != "cells")
+      throw std::runtime_error("Error. Invalid block weight: " + this->BlockWeight);
+  }
+  if (!vm["rebalance-interval"].empty())
+    this->RebalanceInterval = vm["rebalance-interval"].as<vtkm::Id>();
+
+  if (!vm["roi"].empty())
+  {
+    auto roi = vm["roi"].as<std::vector<double>>();
+    if (roi.size() != 6 || roi[0] > roi[1] || roi[2] > roi[3] || roi[4] > roi[5])
+      throw std::runtime_error("Error. --roi must be xmin xmax ymin ymax zmin zmax.");
+    this->UseROI = true;
+    this->ROI = vtkm::Bounds(roi[0], roi[1], roi[2], roi[3], roi[4], roi[5]);
+  }
+}
+
+DataSetReader::~DataSetReader()
+{
+#ifdef ENABLE_MPI
+  int finalized = 0;
+  MPI_Finalized(&finalized);
+  if (!finalized && this->Comm != MPI_COMM_WORLD)
+    MPI_Comm_free(&this->Comm);
+#endif
+}
+
+void
+DataSetReader::SetBlockValueFilter(const std::string& fieldName, const std::vector<double>& values)
+{
+  this->ValueFilterField = fieldName;
+  this->ValueFilterValues = values;
+}
+
+void
+DataSetReader::SetBlockSelection(const std::vector<std::size_t>& blocks)
+{
+  std::size_t nBlocks = 0;
+  if (this->MetaData.Has(fides::keys::NUMBER_OF_BLOCKS()))
+    nBlocks = this->MetaData.Get<fides::metadata::Size>(fides::keys::NUMBER_OF_BLOCKS()).NumberOfItems;
+  for (const auto& b : blocks)
+    if (b >= nBlocks)
+      throw std::runtime_error("Error. Block " + std::to_string(b) + " out of range (" + std::to_string(nBlocks) + " blocks).");
+
+  this->BlocksSet = true;
+  this->BlockSelection = blocks;
+  this->UpdateSelections();
 }
 
 void
 DataSetReader::InitBlockSelection()
 {
-    if (this->Rank == 0) std::cout<<__LINE__<<" "<<__FILE__<<std::endl;
-    this->BlockSelection.clear();
+  this->BlockSelection.clear();
 
-    int nBlocks = static_cast<int>(this->MetaData.Get<fides::metadata::Size>(fides::keys::NUMBER_OF_BLOCKS()).NumberOfItems);
+  std::size_t nBlocks = this->MetaData.Get<fides::metadata::Size>(fides::keys::NUMBER_OF_BLOCKS()).NumberOfItems;
+  if (this->Rank == 0)
     std::cout<<"nBlocks = "<<nBlocks<<std::endl;
 
-    // Default is to load everything.
-    if (this->NumRanks == 1)
-      return;
+  // Default is to load everything.
+  if (this->NumRanks == 1)
+  {
+    this->UpdateSelections();
+    return;
+  }
+
+  std::vector<double> weights(nBlocks, 1.0);
+  if (this->EngineType == "BPFile" && !this->BlockWeight.empty())
+    weights = this->GetBlockWeights(nBlocks);
 
-    if (this->Rank == 0) std::cout<<__LINE__<<" "<<__FILE__<<std::endl;
+  this->AssignBlocks(weights);
+}
+
+//Weight each block by the number of points or cells, taken from the BP file metadata.
+std::vector<double>
+DataSetReader::GetBlockWeights(std::size_t numBlocks) const
+{
+  std::vector<double> weights(numBlocks, 1.0);
 
-    int nPer = nBlocks / this->NumRanks;
-    int remainder = nBlocks % this->NumRanks;
+  if (this->Rank == 0)
+  {
+    auto assoc = vtkm::cont::Field::Association::Points;
+    if (this->BlockWeight == "cells")
+      assoc = vtkm::cont::Field::Association::Cells;
+
+    try
+    {
+      BlockMetaData blockMetaData(this->FileName);
+
+      //Use the first field with the requested association that is an ADIOS variable.
+      std::string varName;
+      if (this->MetaData.Has(fides::keys::FIELDS()))
+      {
+        using FieldInfoType = fides::metadata::Vector<fides::metadata::FieldInformation>;
+        for (const auto& field : this->MetaData.Get<FieldInfoType>(fides::keys::FIELDS()).Data)
+        {
+          if (field.Association == assoc && blockMetaData.HasVariable(field.Name))
+          {
+            varName = field.Name;
+            break;
+          }
+        }
+      }
+
+      if (varName.empty())
+        std::cerr<<"Warning: No "<<this->BlockWeight<<" variable found for block weights."<<std::endl;
+      else
+      {
+        auto sizes = blockMetaData.GetBlockSizes(varName, 0);
+        if (sizes.size() == numBlocks)
+          std::copy(sizes.begin(), sizes.end(), weights.begin());
+        else
+          std::cerr<<"Warning: "<<varName<<" has "<<sizes.size()<<" blocks, expected "<<numBlocks<<std::endl;
+      }
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr<<"Warning: Block weights not available. "<<e.what()<<std::endl;
+    }
+  }
+
+#ifdef ENABLE_MPI
+  MPI_Bcast(weights.data(), static_cast<int>(numBlocks), MPI_DOUBLE, 0, this->Comm);
+#endif
+
+  return weights;
+}
+
+//Give each rank a contiguous range of blocks with about the same total weight.
+//A block goes to the rank that owns the middle of its weight interval.
+void
+DataSetReader::AssignBlocks(const std::vector<double>& weights)
+{
+  std::lock_guard<std::mutex> lock(this->BlockCostMutex);
 
-    int b0 = this->Rank * nPer;
-    int b1 = b0 + nPer;
-    if (this->Rank == this->NumRanks-1)
-      b1 = nBlocks;
+  std::size_t nBlocks = weights.size();
+  double total = std::accumulate(weights.begin(), weights.end(), 0.0);
 
-    for (int b = b0; b < b1; b++)
+  this->BlockWeights = weights;
+  if (total <= 0.0)
+  {
+    total = static_cast<double>(nBlocks);
+    std::fill(this->BlockWeights.begin(), this->BlockWeights.end(), 1.0);
+  }
+
+  this->BlockSelection.clear();
+  double offset = 0.0;
+  for (std::size_t b = 0; b < nBlocks; b++)
+  {
+    double center = offset + this->BlockWeights[b] / 2.0;
+    int rank = std::min(static_cast<int>(center / total * this->NumRanks), this->NumRanks-1);
+    if (rank == this->Rank)
       this->BlockSelection.push_back(b);
+    offset += this->BlockWeights[b];
+  }
+
+  this->UpdateSelections();
+
+  if (this->BlockSelection.empty())
+    std::cout<<"Rank: "<<this->Rank<<" has no blocks"<<std::endl;
+  else
+    std::cout<<"Rank: "<<this->Rank<<" has blocks: "<<this->BlockSelection.front()<<" "<<this->BlockSelection.back()+1<<std::endl;
+}
+
+void
+DataSetReader::RecordStepCost(const std::vector<vtkm::Id>& blockIDs, double seconds)
+{
+  if (this->RebalanceInterval <= 0 || this->NumRanks == 1)
+    return;
+
+  std::lock_guard<std::mutex> lock(this->BlockCostMutex);
+  std::size_t nBlocks = this->BlockWeights.size();
+  if (this->BlockCosts.size() != nBlocks)
+  {
+    this->BlockCosts.assign(nBlocks, 0.0);
+    this->BlockCostCounts.assign(nBlocks, 0.0);
+  }
+
+  //Split the time over the blocks of the step in proportion to their weights.
+  double localWeight = 0.0;
+  for (const auto& b : blockIDs)
+    if (static_cast<std::size_t>(b) < nBlocks)
+      localWeight += this->BlockWeights[static_cast<std::size_t>(b)];
+  if (localWeight <= 0.0)
+    return;
+
+  for (const auto& b : blockIDs)
+  {
+    auto idx = static_cast<std::size_t>(b);
+    if (idx >= nBlocks)
+      continue;
+    this->BlockCosts[idx] += seconds * this->BlockWeights[idx] / localWeight;
+    this->BlockCostCounts[idx] += 1.0;
+  }
+}
+
+//Collective. Reassign the blocks using the average measured cost of each block as its weight.
+void
+DataSetReader::RebalanceBlocks()
+{
+  std::vector<double> costs, counts;
+  {
+    std::lock_guard<std::mutex> lock(this->BlockCostMutex);
+    costs.swap(this->BlockCosts);
+    counts.swap(this->BlockCostCounts);
+  }
+  std::size_t nBlocks = this->BlockWeights.size();
+  costs.resize(nBlocks, 0.0);
+  counts.resize(nBlocks, 0.0);
+
+#ifdef ENABLE_MPI
+  MPI_Allreduce(MPI_IN_PLACE, costs.data(), static_cast<int>(nBlocks), MPI_DOUBLE, MPI_SUM, this->Comm);
+  MPI_Allreduce(MPI_IN_PLACE, counts.data(), static_cast<int>(nBlocks), MPI_DOUBLE, MPI_SUM, this->Comm);
+#endif
+
+  double totalCost = 0.0;
+  std::size_t numMeasured = 0;
+  for (std::size_t b = 0; b < nBlocks; b++)
+  {
+    if (counts[b] > 0.0)
+    {
+      costs[b] /= counts[b];
+      totalCost += costs[b];
+      numMeasured++;
+    }
+  }
+  if (numMeasured == 0)
+    return;
+
+  //Blocks without a measurement get the average cost.
+  double avgCost = totalCost / static_cast<double>(numMeasured);
+  for (std::size_t b = 0; b < nBlocks; b++)
+    if (counts[b] == 0.0)
+      costs[b] = avgCost;
+
+  if (this->Rank == 0)
+    std::cout<<"Rebalancing blocks at step "<<this->Step<<std::endl;
+  this->AssignBlocks(costs);
+}
 
-    std::cout<<"Rank: "<<this->Rank<<" has blocks: "<<b0<<" "<<b1<<std::endl;
+fides::StepStatus
+DataSetReader::BeginStep()
+{
+  if (!this->InitCalled)
+    throw std::runtime_error("Error: Init must be called before BeginStep().");
+
+  fides::StepStatus status = fides::StepStatus::OK;
+  if (this->EngineType == "SST")
+  {
+    while (true)
+    {
+      if (this->Steps.IsPast(this->Step))
+        return fides::StepStatus::EndOfStream;
+
+      status = this->WaitPolicy.Wait([this]() { return this->FidesReader->PrepareNextStep(this->Paths); });
+      if (status != fides::StepStatus::OK)
+        break;
+
+      //Blocks can change from step to step in a stream, so get the metadata for each step.
+      if (this->NumRanks > 1 || !this->FieldNames.empty())
+      {
+        this->MetaData = this->FidesReader->ReadMetaData(this->Paths);
+        if (this->MetaData.Has(fides::keys::NUMBER_OF_BLOCKS()))
+          this->InitBlockSelection();
+        else
+          this->UpdateSelections();
+        //SST has no metadata before the first step, so the fields are printed here.
+        this->PrintFieldSelection();
+      }
+
+      if (this->Steps.Contains(this->Step))
+        break;
+
+      //A stream step has to be read to move past it. Use --output-steps on the producer so it is not sent.
+      this->ReadSelections(this->Step);
+      this->Step++;
+    }
+  }
+  else if (this->Step >= this->NumSteps || this->Steps.IsPast(this->Step))
+    status = fides::StepStatus::EndOfStream;
+  else if (this->RebalanceInterval > 0 && this->NumRanks > 1 && this->NumStepsRead > 0 &&
+           this->NumStepsRead % this->RebalanceInterval == 0)
+    this->RebalanceBlocks();
+
+  return status;
+}
+
+void
+DataSetReader::EndStep()
+{
+  //BP files are read at random, so go straight to the next selected step.
+  if (this->EngineType == "BPFile")
+    this->Step += this->Steps.GetStride();
+  else
+    this->Step++;
+  this->NumStepsRead++;
 }
 
 void
 DataSetReader::Init()
 {
-  this->MetaData = this->FidesReader->ReadMetaData(this->Paths);
   this->InitCalled = true;
 
-  if (this->MetaData.Has(fides::keys::NUMBER_OF_BLOCKS()))
-    this->InitBlockSelection();
-
   //For BPfile method...
   if (this->EngineType == "BPFile")
   {
+    this->MetaData = this->FidesReader->ReadMetaData(this->Paths);
+    if (this->MetaData.Has(fides::keys::NUMBER_OF_BLOCKS()))
+      this->InitBlockSelection();
+    else
+      this->UpdateSelections();
+
     if (this->MetaData.Has(fides::keys::NUMBER_OF_STEPS()))
       this->NumSteps = this->MetaData.Get<fides::metadata::Size>(fides::keys::NUMBER_OF_STEPS()).NumberOfItems;
     else
       this->NumSteps = 1;
     std::cout<<"***** NSTEPS= "<<this->NumSteps<<std::endl;
+
+    this->Step = this->Steps.GetStart();
+    if (!this->Steps.IsAll() && this->Rank == 0)
+      std::cout<<"Reading "<<this->GetSelectedSteps().size()<<" of "<<this->NumSteps<<" steps"<<std::endl;
+
+    if (this->UseROI && this->MetaData.Has(fides::keys::NUMBER_OF_BLOCKS()))
+    {
+      this->InitROIBlocks();
+      this->UpdateSelections();
+    }
+    this->PrintFieldSelection();
   }
   else if (this->EngineType == "SST")
   {
+    //metadata is not available until the first step is ready. See BeginStep().
     std::cout<<"SST init."<<std::endl;
   }
 
@@ -133,29 +432,393 @@ DataSetReader::SetBlocksMetaData(fides::metadata::MetaData& md) const
     numBlocks = this->MetaData.Get<fides::metadata::Size>(fides::keys::NUMBER_OF_BLOCKS()).NumberOfItems;
 }
 
-vtkm::cont::PartitionedDataSet DataSetReader::Read()
+//Build the selections once. Called when the blocks for this rank change.
+void
+DataSetReader::UpdateSelections()
 {
-  auto md = this->MetaData;
+  this->ApplyROIBlocks();
 
-  if (this->EngineType == "BP5")
-    md.Set(fides::keys::STEP_SELECTION(), fides::metadata::Index(this->Step));
-
-  //this->SetBlocksMetaData(md);
-
-  if (this->Rank == 0) std::cout<<__LINE__<<" "<<__FILE__<<std::endl;
+  this->Selections = fides::metadata::MetaData();
   if (!this->BlockSelection.empty())
   {
-    if (this->Rank == 0) std::cout<<__LINE__<<" "<<__FILE__<<std::endl;
-    if (this->Rank == 0) std::cout<<"block sel: "<<this->BlockSelection.size()<<std::endl;
     fides::metadata::Vector<std::size_t> blockSel(this->BlockSelection);
-    md.Set(fides::keys::BLOCK_SELECTION(), blockSel);
+    this->Selections.Set(fides::keys::BLOCK_SELECTION(), blockSel);
   }
-  if (this->Rank == 0) std::cout<<__LINE__<<" "<<__FILE__<<std::endl;
 
-  auto output = this->FidesReader->ReadDataSet(this->Paths, md);
+  auto fields = this->GetFieldSelection();
+  if (!fields.Data.empty())
+    this->Selections.Set(fides::keys::FIELDS(), fields);
+}
+
+//The fields of the data model named in FieldNames.
+fides::metadata::Vector<fides::metadata::FieldInformation>
+DataSetReader::GetFieldSelection() const
+{
+  using FieldInfoType = fides::metadata::Vector<fides::metadata::FieldInformation>;
+  FieldInfoType selection;
+  if (this->FieldNames.empty() || !this->MetaData.Has(fides::keys::FIELDS()))
+    return selection;
+
+  auto names = this->FieldNames;
+  if (this->RemoveGhostCells)
+    names.push_back(this->GhostCellFieldName.empty() ? vtkm::cont::GetGlobalGhostCellFieldName() : this->GhostCellFieldName);
+
+  for (const auto& field : this->MetaData.Get<FieldInfoType>(fides::keys::FIELDS()).Data)
+  {
+    for (const auto& name : names)
+    {
+      if (field.Name == name || field.Name + "_point" == name)
+      {
+        selection.Data.push_back(field);
+        break;
+      }
+    }
+  }
+  return selection;
+}
+
+//Print the field selection once. The selections are rebuilt whenever the blocks change.
+void
+DataSetReader::PrintFieldSelection()
+{
+  if (this->FieldsPrinted || !this->Selections.Has(fides::keys::FIELDS()))
+    return;
+
+  this->FieldsPrinted = true;
+  if (this->Rank == 0)
+  {
+    const auto& fields = this->Selections.Get<fides::metadata::Vector<fides::metadata::FieldInformation>>(fides::keys::FIELDS());
+    std::cout<<"Reading fields:";
+    for (const auto& field : fields.Data)
+      std::cout<<" "<<field.Name;
+    std::cout<<std::endl;
+  }
+}
+
+//Collective. The blocks of this rank where the range of ValueFilterField holds one of ValueFilterValues.
+//Returns false if the block ranges are not available.
+bool
+DataSetReader::GetBlocksWithValues(vtkm::Id step, std::vector<std::size_t>& blocks)
+{
+  std::size_t nBlocks = this->MetaData.Get<fides::metadata::Size>(fides::keys::NUMBER_OF_BLOCKS()).NumberOfItems;
+
+  //Rank 0 reads the ranges. The first value says if they are available.
+  std::vector<char> hasValue(nBlocks + 1, 0);
+  if (this->Rank == 0)
+  {
+    try
+    {
+      if (!this->ValueFilterMetaData)
+        this->ValueFilterMetaData.reset(new BlockMetaData(this->FileName));
+
+      //A point field averaged from a cell field (X_point) has the range of X.
+      std::string varName = this->ValueFilterField;
+      const std::string suffix = "_point";
+      if (!this->ValueFilterMetaData->HasVariable(varName) && varName.size() > suffix.size() &&
+          varName.compare(varName.size() - suffix.size(), suffix.size(), suffix) == 0)
+        varName = varName.substr(0, varName.size() - suffix.size());
+
+      if (!this->ValueFilterMetaData->HasVariable(varName))
+        std::cerr<<"Warning: No variable "<<this->ValueFilterField<<" for block ranges."<<std::endl;
+      else
+      {
+        auto ranges = this->ValueFilterMetaData->GetBlockRanges(varName, static_cast<std::size_t>(step));
+        if (ranges.size() == nBlocks)
+        {
+          hasValue[0] = 1;
+          for (std::size_t b = 0; b < nBlocks; b++)
+          {
+            for (const auto& v : this->ValueFilterValues)
+            {
+              if (ranges[b].first <= v && v <= ranges[b].second)
+              {
+                hasValue[b+1] = 1;
+                break;
+              }
+            }
+          }
+        }
+        else
+          std::cerr<<"Warning: "<<varName<<" has "<<ranges.size()<<" block ranges, expected "<<nBlocks<<std::endl;
+      }
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr<<"Warning: Block ranges not available. "<<e.what()<<std::endl;
+    }
+  }
+
+#ifdef ENABLE_MPI
+  MPI_Bcast(hasValue.data(), static_cast<int>(hasValue.size()), MPI_CHAR, 0, this->Comm);
+#endif
+
+  if (!hasValue[0])
+    return false;
+
+  blocks.clear();
+  if (!this->GetReadsBlockSelection())
+  {
+    for (std::size_t b = 0; b < nBlocks; b++)
+      if (hasValue[b+1])
+        blocks.push_back(b);
+  }
+  else
+  {
+    for (const auto& b : this->BlockSelection)
+      if (hasValue[b+1])
+        blocks.push_back(b);
+  }
+
+  if (this->Rank == 0)
+  {
+    auto numRead = std::count(hasValue.begin() + 1, hasValue.end(), 1);
+    std::cout<<"Step "<<step<<": "<<numRead<<" of "<<nBlocks<<" blocks hold a value of "<<this->ValueFilterField<<std::endl;
+  }
+  return true;
+}
+
+vtkm::cont::PartitionedDataSet DataSetReader::ReadSelections(vtkm::Id step)
+{
+  //Skip the blocks without the filter values. Collective, so it comes before any rank returns.
+  if (!this->ValueFilterField.empty() && this->EngineType == "BPFile" &&
+      this->MetaData.Has(fides::keys::NUMBER_OF_BLOCKS()))
+  {
+    std::vector<std::size_t> blocks;
+    if (this->GetBlocksWithValues(step, blocks))
+    {
+      this->ReadBlockIDs.assign(blocks.begin(), blocks.end());
+      if (blocks.empty())
+        return vtkm::cont::PartitionedDataSet();
+
+      auto selections = this->Selections;
+      selections.Set(fides::keys::BLOCK_SELECTION(), fides::metadata::Vector<std::size_t>(blocks));
+      auto output = this->FidesReader->ReadDataSet(this->Paths, selections);
+      if (this->RemoveGhostCells)
+        output = this->RunRemoveGhostCells(output);
+      if (this->UseROI)
+        output = this->CropToROI(output);
+      return output;
+    }
+
+    //Not available, so stop checking.
+    this->ValueFilterField.clear();
+  }
+
+  this->ReadBlockIDs.assign(this->BlockSelection.begin(), this->BlockSelection.end());
+
+  //An empty selection would read every block.
+  if (this->GetReadsBlockSelection() && this->BlockSelection.empty())
+    return vtkm::cont::PartitionedDataSet();
+
+  auto output = this->FidesReader->ReadDataSet(this->Paths, this->Selections);
   if (this->RemoveGhostCells)
     output = this->RunRemoveGhostCells(output);
+  if (this->UseROI)
+    output = this->CropToROI(output);
+
+  return output;
+}
+
+vtkm::cont::PartitionedDataSet DataSetReader::Read()
+{
+  if (this->EngineType == "BPFile")
+    this->Selections.Set(fides::keys::STEP_SELECTION(), fides::metadata::Index(this->Step));
+
+  return this->ReadSelections(this->Step);
+}
+
+vtkm::cont::PartitionedDataSet DataSetReader::ReadDataSet(vtkm::Id step)
+{
+  this->Selections.Set(fides::keys::STEP_SELECTION(), fides::metadata::Index(step));
+
+  return this->ReadSelections(step);
+}
+
+//Collective. Flag the blocks that overlap the ROI.
+//The block bounds come from reading only the geometry (no fields) of the blocks of each rank at the first step.
+//The geometry is assumed not to change from step to step.
+void
+DataSetReader::InitROIBlocks()
+{
+  std::size_t nBlocks = this->MetaData.Get<fides::metadata::Size>(fides::keys::NUMBER_OF_BLOCKS()).NumberOfItems;
+  std::vector<std::size_t> blockIDs = this->BlockSelection;
+  if (this->NumRanks == 1 && blockIDs.empty())
+  {
+    blockIDs.resize(nBlocks);
+    std::iota(blockIDs.begin(), blockIDs.end(), 0);
+  }
+
+  //Bounds of each block, summed over the ranks. The last value counts the ranks that could not match
+  //their partitions to blocks.
+  std::vector<double> bounds(6*nBlocks + 1, 0.0);
+  if (!blockIDs.empty())
+  {
+    auto selections = this->Selections;
+    selections.Set(fides::keys::STEP_SELECTION(), fides::metadata::Index(this->Step));
+    selections.Set(fides::keys::FIELDS(), fides::metadata::Vector<fides::metadata::FieldInformation>());
+    auto geometry = this->FidesReader->ReadDataSet(this->Paths, selections);
+
+    if (static_cast<std::size_t>(geometry.GetNumberOfPartitions()) != blockIDs.size())
+      bounds.back() = 1.0;
+    else
+    {
+      for (std::size_t i = 0; i < blockIDs.size(); i++)
+      {
+        auto b = geometry.GetPartition(static_cast<vtkm::Id>(i)).GetCoordinateSystem().GetBounds();
+        double* blockBounds = &bounds[6*blockIDs[i]];
+        blockBounds[0] = b.X.Min;
+        blockBounds[1] = b.X.Max;
+        blockBounds[2] = b.Y.Min;
+        blockBounds[3] = b.Y.Max;
+        blockBounds[4] = b.Z.Min;
+        blockBounds[5] = b.Z.Max;
+      }
+    }
+  }
+
+#ifdef ENABLE_MPI
+  MPI_Allreduce(MPI_IN_PLACE, bounds.data(), static_cast<int>(bounds.size()), MPI_DOUBLE, MPI_SUM, this->Comm);
+#endif
+
+  this->ROIBlocks.clear();
+  if (bounds.back() > 0.0)
+  {
+    if (this->Rank == 0)
+      std::cerr<<"Warning: Block bounds not available. Reading every block for --roi."<<std::endl;
+    return;
+  }
+
+  this->ROIBlocks.resize(nBlocks, 0);
+  for (std::size_t b = 0; b < nBlocks; b++)
+  {
+    const double* blockBounds = &bounds[6*b];
+    this->ROIBlocks[b] = (blockBounds[0] <= this->ROI.X.Max && this->ROI.X.Min <= blockBounds[1] &&
+                          blockBounds[2] <= this->ROI.Y.Max && this->ROI.Y.Min <= blockBounds[3] &&
+                          blockBounds[4] <= this->ROI.Z.Max && this->ROI.Z.Min <= blockBounds[5]);
+  }
+
+  if (this->Rank == 0)
+  {
+    auto numRead = std::count(this->ROIBlocks.begin(), this->ROIBlocks.end(), 1);
+    std::cout<<"ROI overlaps "<<numRead<<" of "<<nBlocks<<" blocks"<<std::endl;
+  }
+}
+
+//Remove the blocks outside the ROI from the blocks of this rank.
+void
+DataSetReader::ApplyROIBlocks()
+{
+  if (this->ROIBlocks.empty())
+    return;
+
+  //Every block is read on one rank.
+  if (this->NumRanks == 1 && !this->BlocksSet && this->BlockSelection.empty())
+  {
+    this->BlockSelection.resize(this->ROIBlocks.size());
+    std::iota(this->BlockSelection.begin(), this->BlockSelection.end(), 0);
+  }
+
+  auto outside = [this](std::size_t b) { return b >= this->ROIBlocks.size() || !this->ROIBlocks[b]; };
+  this->BlockSelection.erase(std::remove_if(this->BlockSelection.begin(), this->BlockSelection.end(), outside),
+                             this->BlockSelection.end());
+}
+
+//Point index range [i0, i1) of the coordinates along one axis that covers [minVal, maxVal].
+//Includes the points on either side, so the cells that hold the ends of the range are kept.
+static vtkm::Id2
+GetAxisExtent(const std::vector<double>& coords, double minVal, double maxVal)
+{
+  vtkm::Id n = static_cast<vtkm::Id>(coords.size());
+  if (n == 0 || maxVal < coords.front() || minVal > coords.back())
+    return vtkm::Id2(0, 0);
+
+  auto lo = std::upper_bound(coords.begin(), coords.end(), minVal);
+  auto hi = std::lower_bound(coords.begin(), coords.end(), maxVal);
+  vtkm::Id i0 = std::max(static_cast<vtkm::Id>(lo - coords.begin()) - 1, vtkm::Id(0));
+  vtkm::Id i1 = std::min(static_cast<vtkm::Id>(hi - coords.begin()) + 1, n);
+  return vtkm::Id2(i0, i1);
+}
+
+template <typename T>
+static bool
+GetRectilinearCoordinates(const vtkm::cont::CoordinateSystem& coords, std::vector<double> axes[3])
+{
+  using AxisType = vtkm::cont::ArrayHandle<T>;
+  using CoordsType = vtkm::cont::ArrayHandleCartesianProduct<AxisType, AxisType, AxisType>;
+  if (!coords.GetData().IsType<CoordsType>())
+    return false;
+
+  auto rectCoords = coords.GetData().AsArrayHandle<CoordsType>();
+  AxisType arrays[3] = { rectCoords.GetFirstArray(), rectCoords.GetSecondArray(), rectCoords.GetThirdArray() };
+  for (int d = 0; d < 3; d++)
+  {
+    auto portal = arrays[d].ReadPortal();
+    axes[d].resize(static_cast<std::size_t>(portal.GetNumberOfValues()));
+    for (vtkm::Id i = 0; i < portal.GetNumberOfValues(); i++)
+      axes[d][static_cast<std::size_t>(i)] = static_cast<double>(portal.Get(i));
+  }
+  return true;
+}
+
+//Cut the uniform and rectilinear partitions down to the points that cover the ROI.
+//Other partitions are kept whole. Partitions outside the ROI are removed.
+vtkm::cont::PartitionedDataSet
+DataSetReader::CropToROI(const vtkm::cont::PartitionedDataSet& input)
+{
+  bool hasIDs = (this->ReadBlockIDs.size() == static_cast<std::size_t>(input.GetNumberOfPartitions()));
+  std::vector<vtkm::Id> blockIDs;
+  vtkm::cont::PartitionedDataSet output;
+
+  for (vtkm::Id i = 0; i < input.GetNumberOfPartitions(); i++)
+  {
+    const auto& ds = input.GetPartition(i);
+    const auto& coords = ds.GetCoordinateSystem();
+
+    std::vector<double> axes[3];
+    bool structured = ds.GetCellSet().IsType<vtkm::cont::CellSetStructured<3>>();
+    if (structured && coords.GetData().IsType<vtkm::cont::ArrayHandleUniformPointCoordinates>())
+    {
+      auto portal = coords.GetData().AsArrayHandle<vtkm::cont::ArrayHandleUniformPointCoordinates>().ReadPortal();
+      auto dims = portal.GetDimensions();
+      auto origin = portal.GetOrigin();
+      auto spacing = portal.GetSpacing();
+      for (int d = 0; d < 3; d++)
+        for (vtkm::Id j = 0; j < dims[d]; j++)
+          axes[d].push_back(static_cast<double>(origin[d]) + static_cast<double>(j) * static_cast<double>(spacing[d]));
+    }
+    else if (structured && !GetRectilinearCoordinates<vtkm::Float32>(coords, axes))
+      structured = GetRectilinearCoordinates<vtkm::Float64>(coords, axes);
+
+    if (!structured)
+    {
+      output.AppendPartition(ds);
+      if (hasIDs)
+        blockIDs.push_back(this->ReadBlockIDs[static_cast<std::size_t>(i)]);
+      continue;
+    }
+
+    auto x = GetAxisExtent(axes[0], this->ROI.X.Min, this->ROI.X.Max);
+    auto y = GetAxisExtent(axes[1], this->ROI.Y.Min, this->ROI.Y.Max);
+    auto z = GetAxisExtent(axes[2], this->ROI.Z.Min, this->ROI.Z.Max);
+    if (x[0] >= x[1] || y[0] >= y[1] || z[0] >= z[1])
+      continue;
+
+    if (x[1]-x[0] == static_cast<vtkm::Id>(axes[0].size()) &&
+        y[1]-y[0] == static_cast<vtkm::Id>(axes[1].size()) &&
+        z[1]-z[0] == static_cast<vtkm::Id>(axes[2].size()))
+      output.AppendPartition(ds);
+    else
+    {
+      vtkm::filter::entity_extraction::ExtractStructured extract;
+      extract.SetVOI(vtkm::RangeId3(x[0], x[1], y[0], y[1], z[0], z[1]));
+      output.AppendPartition(extract.Execute(ds));
+    }
+    if (hasIDs)
+      blockIDs.push_back(this->ReadBlockIDs[static_cast<std::size_t>(i)]);
+  }
 
+  if (hasIDs)
+    this->ReadBlockIDs = blockIDs;
   return output;
 }
 
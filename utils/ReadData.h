@@ -1,7 +1,11 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include "CommandLineArgParser.h"
+#include "StepRange.h"
+#include "StepWait.h"
+#include <vtkm/Bounds.h>
 #include <vtkm/io/VTKDataSetReader.h>
 
 #include <fides/DataSetReader.h>
@@ -15,51 +19,50 @@ namespace xenia
 {
 namespace utils
 {
+class BlockMetaData;
+
 class DataSetReader
 {
   public:
   DataSetReader(const boost::program_options::variables_map& vm);
+  ~DataSetReader();
 
   void Init();
   vtkm::Id GetNumSteps() const { return this->NumSteps; }
+  //The steps of a BP file selected with --steps start:stop:stride (every step by default).
+  std::vector<vtkm::Id> GetSelectedSteps() const { return this->Steps.GetSteps(this->NumSteps); }
+  vtkm::Id GetStep() const { return this->Step; }
+  const std::string& GetEngineType() const { return this->EngineType; }
   vtkm::cont::PartitionedDataSet Read();
 
   int GetRank() const { return this->Rank;}
+  const StepWaitPolicy& GetWaitPolicy() const { return this->WaitPolicy; }
 
-  fides::StepStatus BeginStep()
-  {
-    if (!this->InitCalled)
-      throw std::runtime_error("Error: Init must be called before BeginStep().");
+  const std::vector<std::size_t>& GetBlockSelection() const { return this->BlockSelection; }
+  //Global block id of each partition from the last read. Empty when every block was read on one rank.
+  const std::vector<vtkm::Id>& GetReadBlockIDs() const { return this->ReadBlockIDs; }
 
-    fides::StepStatus status = fides::StepStatus::OK;
-    if (this->EngineType == "SST")
-      status = this->FidesReader->PrepareNextStep(this->Paths);
+  //Only read the blocks where the range of fieldName holds one of values (e.g. contour isovalues).
+  //The ranges are the block min/max in the BP file metadata. Every block is read if they are not available.
+  void SetBlockValueFilter(const std::string& fieldName, const std::vector<double>& values);
 
-    return status;
-  }
-  void EndStep()
-  {
-    this->Step++;
-  }
+  //Read only these global blocks, on every rank. Blocks outside of --roi are still skipped. Call after Init().
+  void SetBlockSelection(const std::vector<std::size_t>& blocks);
 
-  vtkm::cont::PartitionedDataSet
-  ReadDataSet(vtkm::Id step)
-  {
-    auto selections = this->MetaData;
-    selections.Set(fides::keys::STEP_SELECTION(), fides::metadata::Index(step));
-    //change this to set it on MetaData once.
-    if (!this->BlockSelection.empty())
-    {
-      fides::metadata::Vector<std::size_t> blockSel(this->BlockSelection);
-      selections.Set(fides::keys::BLOCK_SELECTION(), blockSel);
-    }
-    auto output = this->FidesReader->ReadDataSet(this->Paths, selections);
+  //Only read these fields (and the ghost cell field). X_point reads cell field X. Call before Init().
+  //Names not in the data model are ignored. Empty reads every field.
+  void SetFieldSelection(const std::vector<std::string>& fieldNames) { this->FieldNames = fieldNames; }
 
-    if (this->RemoveGhostCells)
-      output = this->RunRemoveGhostCells(output);
+  //Time spent processing the blocks blockIDs (see GetReadBlockIDs) of one step.
+  //With --rebalance-interval, these costs are used to move blocks between ranks.
+  //Safe to call while another thread reads the next step.
+  void RecordStepCost(const std::vector<vtkm::Id>& blockIDs, double seconds);
 
-    return output;
-  }
+  //Steps outside of --steps are skipped. BP files go straight to the next selected step.
+  fides::StepStatus BeginStep();
+  void EndStep();
+
+  vtkm::cont::PartitionedDataSet ReadDataSet(vtkm::Id step);
 
   vtkm::cont::PartitionedDataSet
   ReadDataSet()
@@ -76,6 +79,18 @@ class DataSetReader
 private:
   void SetBlocksMetaData(fides::metadata::MetaData& md) const;
   void InitBlockSelection();
+  std::vector<double> GetBlockWeights(std::size_t numBlocks) const;
+  void AssignBlocks(const std::vector<double>& weights);
+  void RebalanceBlocks();
+  void UpdateSelections();
+  fides::metadata::Vector<fides::metadata::FieldInformation> GetFieldSelection() const;
+  void PrintFieldSelection();
+  bool GetBlocksWithValues(vtkm::Id step, std::vector<std::size_t>& blocks);
+  bool GetReadsBlockSelection() const { return this->NumRanks > 1 || this->BlocksSet || !this->ROIBlocks.empty(); }
+  void InitROIBlocks();
+  void ApplyROIBlocks();
+  vtkm::cont::PartitionedDataSet CropToROI(const vtkm::cont::PartitionedDataSet& input);
+  vtkm::cont::PartitionedDataSet ReadSelections(vtkm::Id step);
 
   vtkm::cont::PartitionedDataSet RunRemoveGhostCells(const vtkm::cont::PartitionedDataSet& input) const;
 
@@ -83,18 +98,44 @@ private:
   std::unique_ptr<fides::io::DataSetReader> FidesReader;
   std::unordered_map<std::string, std::string> Paths;
   fides::metadata::MetaData MetaData;
+  //Selections passed to every read. Only the step selection changes from step to step.
+  fides::metadata::MetaData Selections;
   std::vector<std::size_t> BlockSelection;
+  std::vector<std::string> FieldNames;
+  bool FieldsPrinted = false;
+  std::vector<vtkm::Id> ReadBlockIDs;
+  bool BlocksSet = false;
+  //--roi. ROIBlocks flags the global blocks that overlap it (empty when the block bounds are not known).
+  bool UseROI = false;
+  vtkm::Bounds ROI;
+  std::vector<char> ROIBlocks;
+  std::string BlockWeight = "";
+  vtkm::Id RebalanceInterval = 0;
+  std::vector<double> BlockWeights;
+  std::vector<double> BlockCosts;
+  std::vector<double> BlockCostCounts;
+  std::mutex BlockCostMutex;
+  std::string ValueFilterField = "";
+  std::vector<double> ValueFilterValues;
+  std::unique_ptr<BlockMetaData> ValueFilterMetaData;
   std::string JSONFile = "";
   std::string FileName = "";
   std::string EngineType = "BPFile";
+  StepWaitPolicy WaitPolicy;
   bool InitCalled = false;
   vtkm::Id NumSteps = 0;
+  StepRange Steps;
+  vtkm::Id NumStepsRead = 0;
 
   bool RemoveGhostCells = false;
   std::string GhostCellFieldName = "";
 
   int Rank = 0;
   int NumRanks = 1;
+#ifdef ENABLE_MPI
+  //Reads can run on the prefetch thread, so the reader makes its collective calls on its own communicator.
+  MPI_Comm Comm = MPI_COMM_WORLD;
+#endif
 
   static const std::set<std::string> ValidEngineTypes;
 };
@@ -0,0 +1,397 @@
+#include "Render.h"
+
+#include <vtkm/cont/BoundsCompute.h>
+#include <vtkm/rendering/Actor.h>
+#include <vtkm/rendering/MapperCylinder.h>
+#include <vtkm/rendering/MapperRayTracer.h>
+#include <vtkm/rendering/MapperVolume.h>
+#include <vtkm/rendering/Scene.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace xenia
+{
+namespace utils
+{
+
+std::string
+CreateOutputFileName(const std::string& fname, vtkm::Id step)
+{
+  if (fname.find('%') != std::string::npos)
+  {
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), fname.c_str(), step);
+    std::string outFname(buffer);
+    return outFname;
+  }
+  else
+    return fname;
+}
+
+vtkm::rendering::CanvasRayTracer
+MakeCanvas(const boost::program_options::variables_map& vm)
+{
+  vtkm::Vec<vtkm::Id,2> res(1024, 1024);
+
+  if (!vm["imagesize"].empty())
+  {
+    const auto& vals = vm["imagesize"].as<std::vector<int>>();
+    res[0] = static_cast<vtkm::Id>(vals[0]);
+    res[1] = static_cast<vtkm::Id>(vals[1]);
+  }
+
+  auto canvas =vtkm::rendering::CanvasRayTracer(res[0], res[1]);
+  return canvas;
+}
+
+vtkm::rendering::Camera
+MakeCamera(const boost::program_options::variables_map& vm)
+{
+  vtkm::rendering::Camera camera;
+  vtkm::Vec3f_32 position(1.5, 1.5, 1.5);
+  vtkm::Vec3f_32 lookAt(.5, .5, .5);
+  vtkm::Vec3f_32 up(0,1,0);
+  vtkm::FloatDefault fov = 60;
+  vtkm::Vec2f_32 clip(-1.0, 1.0);
+
+  if (!vm["position"].empty())
+  {
+    const auto& vals = vm["position"].as<std::vector<float>>();
+    for (std::size_t i = 0; i < 3; i++)
+      position[i] = vals[i];
+  }
+
+  if (!vm["lookat"].empty())
+  {
+    const auto& vals = vm["lookat"].as<std::vector<float>>();
+    for (int i = 0; i < 3; i++)
+      lookAt[i] = vals[i];
+  }
+  if (!vm["up"].empty())
+  {
+    const auto& vals = vm["up"].as<std::vector<float>>();
+    for (int i = 0; i < 3; i++)
+      up[i] = vals[i];
+  }
+  if (!vm["fov"].empty())
+  {
+    fov = vm["fov"].as<float>();
+  }
+  if (!vm["clip"].empty())
+  {
+    const auto& vals = vm["clip"].as<std::vector<vtkm::FloatDefault>>();
+    clip[0] = vals[0];
+    clip[1] = vals[1];
+  }
+
+  camera.SetPosition(position);
+  camera.SetLookAt(lookAt);
+  camera.SetViewUp(up);
+  camera.SetFieldOfView(fov);
+  camera.SetClippingRange(clip[0], clip[1]);
+
+  return camera;
+}
+
+Renderer::Renderer(const boost::program_options::variables_map& vm)
+  : Background(0.2f, 0.2f, 0.2f, 1.0f)
+  , ScalarRange(0.0, 1.0)
+{
+  if (!vm["output"].empty())
+    this->OutputFileName = vm["output"].as<std::string>();
+  if (!vm["render-field"].empty())
+    this->FieldName = vm["render-field"].as<std::string>();
+  else if (!vm["field"].empty())
+    this->FieldName = vm["field"].as<std::string>();
+
+  std::string colorTableName = "Cool to Warm";
+  if (!vm["color-table"].empty())
+    colorTableName = vm["color-table"].as<std::string>();
+  this->ColorTable = vtkm::cont::ColorTable(colorTableName);
+
+  if (!vm["scalar_range"].empty())
+  {
+    const auto& vals = vm["scalar_range"].as<std::vector<float>>();
+    this->ScalarRange.Min = vals[0];
+    this->ScalarRange.Max = vals[1];
+  }
+
+  if (!vm["scalar-range-mode"].empty())
+    this->RangeMode = vm["scalar-range-mode"].as<std::string>();
+  if (this->RangeMode != "fixed" && this->RangeMode != "auto" && this->RangeMode != "grow" &&
+      this->RangeMode != "smooth" && this->RangeMode != "freeze")
+    throw std::runtime_error("Error. Unknown scalar range mode: " + this->RangeMode);
+  if (!vm["scalar-range-smoothing"].empty())
+    this->RangeSmoothing = vm["scalar-range-smoothing"].as<double>();
+  if (this->RangeSmoothing <= 0.0 || this->RangeSmoothing > 1.0)
+    throw std::runtime_error("Error. --scalar-range-smoothing must be in (0,1].");
+
+  if (!vm["render-mode"].empty())
+    this->RenderMode = vm["render-mode"].as<std::string>();
+  if (this->RenderMode != "surface" && this->RenderMode != "volume" && this->RenderMode != "cylinder")
+    throw std::runtime_error("Error. Unknown render mode: " + this->RenderMode);
+
+  //The view keeps its own canvas and mapper, so they live as long as the renderer.
+  if (this->RenderMode == "volume")
+  {
+    //Opacity transfer function as (position, opacity) pairs, with positions in [0,1] over the scalar range.
+    std::vector<float> opacity = {0.0f, 0.0f, 1.0f, 1.0f};
+    if (!vm["opacity-points"].empty())
+      opacity = vm["opacity-points"].as<std::vector<float>>();
+    if (opacity.empty() || opacity.size() % 2 != 0)
+      throw std::runtime_error("Error. --opacity-points needs pairs of position and opacity.");
+
+    auto tableRange = this->ColorTable.GetRange();
+    this->ColorTable.ClearAlpha();
+    for (std::size_t i = 0; i < opacity.size(); i += 2)
+      this->ColorTable.AddPointAlpha(tableRange.Min + opacity[i] * tableRange.Length(), opacity[i+1]);
+
+    vtkm::rendering::MapperVolume mapper;
+    if (!vm["sample-distance"].empty())
+      mapper.SetSampleDistance(vm["sample-distance"].as<float>());
+
+    //With more than one rank, each rank renders on a transparent background and the images are
+    //blended in visibility order. The background is added after.
+    bool blendRanks = (this->Compositor.GetNumberOfRanks() > 1);
+    mapper.SetCompositeBackground(!blendRanks);
+    this->View.reset(new vtkm::rendering::View3D(vtkm::rendering::Scene(),
+                                                 mapper,
+                                                 MakeCanvas(vm),
+                                                 MakeCamera(vm),
+                                                 blendRanks ? vtkm::rendering::Color(0.0f, 0.0f, 0.0f, 0.0f) : this->Background));
+  }
+  else if (this->RenderMode == "cylinder")
+  {
+    //Without a radius, the mapper picks one from the size of the data.
+    vtkm::rendering::MapperCylinder mapper;
+    if (!vm["tube-size"].empty())
+      mapper.SetRadius(static_cast<vtkm::Float32>(vm["tube-size"].as<vtkm::FloatDefault>()));
+    this->View.reset(new vtkm::rendering::View3D(vtkm::rendering::Scene(),
+                                                 mapper,
+                                                 MakeCanvas(vm),
+                                                 MakeCamera(vm),
+                                                 this->Background));
+  }
+  else
+  {
+    this->View.reset(new vtkm::rendering::View3D(vtkm::rendering::Scene(),
+                                                 vtkm::rendering::MapperRayTracer(),
+                                                 MakeCanvas(vm),
+                                                 MakeCamera(vm),
+                                                 this->Background));
+  }
+  this->View->SetWorldAnnotationsEnabled(false);
+  this->View->SetRenderAnnotationsEnabled(false);
+
+  //PNG images are encoded and written in the background. Only rank 0 writes images.
+  int encodeThreads = 2;
+  if (!vm["encode-threads"].empty())
+    encodeThreads = vm["encode-threads"].as<int>();
+  std::size_t encodeQueue = 4;
+  if (!vm["encode-queue"].empty())
+    encodeQueue = static_cast<std::size_t>(std::max(vm["encode-queue"].as<int>(), 1));
+
+  //No output file name means the caller names the images, which are always PNG.
+  bool isPNG = this->OutputFileName.empty() ||
+               (this->OutputFileName.size() > 4 &&
+                this->OutputFileName.compare(this->OutputFileName.size() - 4, 4, ".png") == 0);
+  if (isPNG && encodeThreads > 0 && this->Compositor.GetRank() == 0)
+    this->ImageWriter.reset(new AsyncImageWriter(encodeThreads, encodeQueue));
+}
+
+void
+Renderer::Render(vtkm::Id step, const vtkm::cont::PartitionedDataSet& pds)
+{
+  if (this->FieldName.empty())
+    return;
+
+  this->SetData(pds);
+
+  auto fname = CreateOutputFileName(this->OutputFileName, step);
+  if (this->Compositor.GetNumberOfRanks() == 1 && !this->ImageWriter)
+  {
+    this->View->Paint();
+    std::cout<<"Render step: "<<step<<" to "<<fname<<std::endl;
+    this->View->SaveAs(fname);
+    return;
+  }
+
+  std::vector<vtkm::Float32> colors, depths;
+  if (!this->RenderImage(colors, depths))
+    return;
+
+  std::cout<<"Render step: "<<step<<" to "<<fname<<std::endl;
+  this->SaveImage(fname, std::move(colors), depths);
+}
+
+void
+Renderer::SetData(const vtkm::cont::PartitionedDataSet& pds)
+{
+  this->UpdateScalarRange(pds);
+
+  vtkm::rendering::Scene scene;
+  for (const auto& ds : pds)
+  {
+    vtkm::rendering::Actor actor(ds.GetCellSet(),
+                                 ds.GetCoordinateSystem(),
+                                 ds.GetField(this->FieldName),
+                                 this->ColorTable);
+    actor.SetScalarRange(this->ScalarRange);
+    scene.AddActor(actor);
+  }
+  this->View->SetScene(scene);
+
+  this->LocalBounds = vtkm::Bounds();
+  if (pds.GetNumberOfPartitions() > 0)
+    this->LocalBounds = vtkm::cont::BoundsCompute(pds);
+}
+
+bool
+Renderer::RenderImage(std::vector<vtkm::Float32>& colors, std::vector<vtkm::Float32>& depths)
+{
+  this->View->Paint();
+
+  this->ReadCanvas(colors, depths);
+  if (this->RenderMode == "volume")
+  {
+    this->Compositor.CompositeOrdered(colors, this->GetVisibilityKey());
+    if (this->Compositor.GetNumberOfRanks() > 1 && this->Compositor.GetRank() == 0)
+      this->BlendBackground(colors);
+  }
+  else
+    this->Compositor.Composite(colors, depths);
+
+  return (this->Compositor.GetRank() == 0);
+}
+
+void
+Renderer::SaveImage(const std::string& fname, std::vector<vtkm::Float32>&& colors, const std::vector<vtkm::Float32>& depths)
+{
+  if (this->ImageWriter)
+  {
+    auto& canvas = this->View->GetCanvas();
+    this->ImageWriter->Push(fname, canvas.GetWidth(), canvas.GetHeight(), std::move(colors));
+  }
+  else
+  {
+    //Put the composited image back into the canvas so it is saved as usual.
+    this->WriteCanvas(colors, depths);
+    this->View->SaveAs(fname);
+  }
+}
+
+void
+Renderer::Finish()
+{
+  if (this->ImageWriter)
+    this->ImageWriter->Finish();
+}
+
+//Range of the field over all ranks for this step, combined with the range of earlier steps by RangeMode.
+void
+Renderer::UpdateScalarRange(const vtkm::cont::PartitionedDataSet& pds)
+{
+  if (this->RangeMode == "fixed" || (this->RangeMode == "freeze" && this->RangeInitialized))
+    return;
+
+  //Negate the min so one MAX reduction gives both.
+  vtkm::Float64 minMax[2] = { -std::numeric_limits<vtkm::Float64>::infinity(),
+                              -std::numeric_limits<vtkm::Float64>::infinity() };
+  for (const auto& ds : pds)
+  {
+    if (!ds.HasField(this->FieldName))
+      continue;
+    auto range = ds.GetField(this->FieldName).GetRange().ReadPortal().Get(0);
+    if (!range.IsNonEmpty())
+      continue;
+    minMax[0] = std::max(minMax[0], -range.Min);
+    minMax[1] = std::max(minMax[1], range.Max);
+  }
+#ifdef ENABLE_MPI
+  MPI_Allreduce(MPI_IN_PLACE, minMax, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+#endif
+
+  vtkm::Range stepRange(-minMax[0], minMax[1]);
+  if (!stepRange.IsNonEmpty())
+    return;
+
+  if (!this->RangeInitialized || this->RangeMode == "auto")
+    this->ScalarRange = stepRange;
+  else if (this->RangeMode == "grow")
+    this->ScalarRange.Include(stepRange);
+  else if (this->RangeMode == "smooth")
+  {
+    double a = this->RangeSmoothing;
+    this->ScalarRange.Min = a * stepRange.Min + (1.0 - a) * this->ScalarRange.Min;
+    this->ScalarRange.Max = a * stepRange.Max + (1.0 - a) * this->ScalarRange.Max;
+  }
+  this->RangeInitialized = true;
+}
+
+//Distance from the camera to the center of the blocks on this rank.
+vtkm::Float32
+Renderer::GetVisibilityKey() const
+{
+  if (!this->LocalBounds.IsNonEmpty())
+    return std::numeric_limits<vtkm::Float32>::max();
+
+  auto center = this->LocalBounds.Center();
+  auto position = this->View->GetCamera().GetPosition();
+  vtkm::Float64 dist2 = 0;
+  for (vtkm::IdComponent i = 0; i < 3; i++)
+    dist2 += (center[i] - position[i]) * (center[i] - position[i]);
+  return static_cast<vtkm::Float32>(std::sqrt(dist2));
+}
+
+//Blend the background behind premultiplied colors.
+void
+Renderer::BlendBackground(std::vector<vtkm::Float32>& colors) const
+{
+  for (std::size_t i = 0; i < colors.size(); i += 4)
+  {
+    vtkm::Float32 transmission = 1.0f - colors[i+3];
+    for (vtkm::IdComponent c = 0; c < 3; c++)
+      colors[i+c] += transmission * this->Background.Components[c];
+    colors[i+3] = 1.0f;
+  }
+}
+
+void
+Renderer::ReadCanvas(std::vector<vtkm::Float32>& colors, std::vector<vtkm::Float32>& depths) const
+{
+  const auto& canvas = this->View->GetCanvas();
+  vtkm::Id numPixels = canvas.GetWidth() * canvas.GetHeight();
+
+  colors.resize(4*numPixels);
+  depths.resize(numPixels);
+  auto colorPortal = canvas.GetColorBuffer().ReadPortal();
+  auto depthPortal = canvas.GetDepthBuffer().ReadPortal();
+  for (vtkm::Id i = 0; i < numPixels; i++)
+  {
+    auto color = colorPortal.Get(i);
+    for (vtkm::IdComponent c = 0; c < 4; c++)
+      colors[4*i + c] = color[c];
+    depths[i] = depthPortal.Get(i);
+  }
+}
+
+void
+Renderer::WriteCanvas(const std::vector<vtkm::Float32>& colors, const std::vector<vtkm::Float32>& depths)
+{
+  auto& canvas = this->View->GetCanvas();
+  vtkm::Id numPixels = canvas.GetWidth() * canvas.GetHeight();
+
+  auto colorPortal = canvas.GetColorBuffer().WritePortal();
+  auto depthPortal = canvas.GetDepthBuffer().WritePortal();
+  for (vtkm::Id i = 0; i < numPixels; i++)
+  {
+    colorPortal.Set(i, vtkm::Vec4f_32(colors[4*i], colors[4*i+1], colors[4*i+2], colors[4*i+3]));
+    depthPortal.Set(i, depths[i]);
+  }
+}
+
+}
+} //xenia::utils
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <vtkm/Bounds.h>
+#include <vtkm/Range.h>
+#include <vtkm/cont/ColorTable.h>
+#include <vtkm/cont/PartitionedDataSet.h>
+#include <vtkm/rendering/Camera.h>
+#include <vtkm/rendering/CanvasRayTracer.h>
+#include <vtkm/rendering/Color.h>
+#include <vtkm/rendering/View3D.h>
+#include <boost/program_options.hpp>
+
+#include "Compositor.h"
+#include "ImageWriter.h"
+
+namespace xenia
+{
+namespace utils
+{
+
+//Replaces a printf style step pattern in fname (e.g. out.%03d.png) with step.
+std::string CreateOutputFileName(const std::string& fname, vtkm::Id step);
+
+vtkm::rendering::CanvasRayTracer MakeCanvas(const boost::program_options::variables_map& vm);
+vtkm::rendering::Camera MakeCamera(const boost::program_options::variables_map& vm);
+
+// Renders one image per step.
+// The canvas, camera, mapper and color table are created once and reused for the whole stream.
+// Only the actors are rebuilt each step.
+// On more than one rank, each rank renders its own blocks and the images are depth composited onto rank 0,
+// which saves the image.
+// --render-mode volume renders the field of uniform or rectilinear grids directly with MapperVolume,
+// using --opacity-points for the opacity transfer function and --sample-distance for the step along each ray.
+// --render-mode cylinder ray traces line and polyline cells (e.g. streamlines) as cylinders of radius --tube-size,
+// so no tube geometry has to be made or sent.
+// --scalar-range-mode sets how the color range is found. fixed (default) uses --scalar_range or [0,1].
+// auto uses the range of each step over all ranks, grow the union of all steps so far, smooth a running
+// average of the step ranges and freeze the range of the first step.
+// PNG images are encoded and written on background threads (--encode-threads, 0 writes them on the render thread).
+class Renderer
+{
+  public:
+  Renderer(const boost::program_options::variables_map& vm);
+
+  //Render the blocks of one step and save the image.
+  void Render(vtkm::Id step, const vtkm::cont::PartitionedDataSet& pds);
+
+  //The steps of Render, for rendering the same data more than once (e.g. from several cameras).
+  //SetData builds the actors. RenderImage paints and composites, and returns true on the rank with the image.
+  void SetData(const vtkm::cont::PartitionedDataSet& pds);
+  bool RenderImage(std::vector<vtkm::Float32>& colors, std::vector<vtkm::Float32>& depths);
+  void SaveImage(const std::string& fname, std::vector<vtkm::Float32>&& colors, const std::vector<vtkm::Float32>& depths);
+
+  const vtkm::rendering::Camera& GetCamera() const { return this->View->GetCamera(); }
+  void SetCamera(const vtkm::rendering::Camera& camera) { this->View->GetCamera() = camera; }
+  vtkm::Id GetWidth() const { return this->View->GetCanvas().GetWidth(); }
+  vtkm::Id GetHeight() const { return this->View->GetCanvas().GetHeight(); }
+
+  //Wait until every image is written.
+  void Finish();
+
+  const std::string& GetFieldName() const { return this->FieldName; }
+
+  private:
+  void UpdateScalarRange(const vtkm::cont::PartitionedDataSet& pds);
+  vtkm::Float32 GetVisibilityKey() const;
+  void BlendBackground(std::vector<vtkm::Float32>& colors) const;
+  void ReadCanvas(std::vector<vtkm::Float32>& colors, std::vector<vtkm::Float32>& depths) const;
+  void WriteCanvas(const std::vector<vtkm::Float32>& colors, const std::vector<vtkm::Float32>& depths);
+
+  ImageCompositor Compositor;
+  std::unique_ptr<AsyncImageWriter> ImageWriter;
+  std::string OutputFileName;
+  std::string FieldName;
+  std::string RenderMode = "surface";
+  vtkm::rendering::Color Background;
+  vtkm::cont::ColorTable ColorTable;
+  vtkm::Range ScalarRange;
+  std::string RangeMode = "fixed";
+  double RangeSmoothing = 0.25;
+  bool RangeInitialized = false;
+  std::unique_ptr<vtkm::rendering::View3D> View;
+  vtkm::Bounds LocalBounds;
+};
+
+}
+} //xenia::utils
@@ -0,0 +1,89 @@
+#include "StepRange.h"
+
+#include <stdexcept>
+
+namespace xenia
+{
+namespace utils
+{
+
+static vtkm::Id
+ParseStep(const std::string& str, const std::string& range)
+{
+  std::size_t pos = 0;
+  long long val = -1;
+  try
+  {
+    val = std::stoll(str, &pos);
+  }
+  catch (const std::exception&)
+  {
+    pos = 0;
+  }
+  if (pos != str.size() || val < 0)
+    throw std::runtime_error("Error. Invalid step range: `" + range + "` (expected start:stop:stride)");
+  return static_cast<vtkm::Id>(val);
+}
+
+StepRange::StepRange(const std::string& range)
+{
+  std::vector<std::string> parts;
+  std::size_t begin = 0;
+  while (true)
+  {
+    auto end = range.find(':', begin);
+    parts.push_back(range.substr(begin, end - begin));
+    if (end == std::string::npos)
+      break;
+    begin = end + 1;
+  }
+  if (parts.size() > 3)
+    throw std::runtime_error("Error. Invalid step range: `" + range + "` (expected start:stop:stride)");
+
+  if (parts.size() == 1)
+  {
+    this->Start = ParseStep(parts[0], range);
+    this->Stop = this->Start + 1;
+    return;
+  }
+
+  if (!parts[0].empty())
+    this->Start = ParseStep(parts[0], range);
+  if (!parts[1].empty())
+    this->Stop = ParseStep(parts[1], range);
+  if (parts.size() == 3 && !parts[2].empty())
+    this->Stride = ParseStep(parts[2], range);
+
+  if (this->Stride < 1)
+    throw std::runtime_error("Error. Step range stride must be at least 1: `" + range + "`");
+}
+
+StepRange::StepRange(const boost::program_options::variables_map& vm, const std::string& name)
+{
+  if (!vm[name].empty())
+    *this = StepRange(vm[name].as<std::string>());
+}
+
+bool
+StepRange::Contains(vtkm::Id step) const
+{
+  if (step < this->Start || this->IsPast(step))
+    return false;
+  return (step - this->Start) % this->Stride == 0;
+}
+
+std::vector<vtkm::Id>
+StepRange::GetSteps(vtkm::Id numSteps) const
+{
+  vtkm::Id stop = numSteps;
+  if (this->Stop >= 0 && this->Stop < stop)
+    stop = this->Stop;
+
+  std::vector<vtkm::Id> steps;
+  for (vtkm::Id step = this->Start; step < stop; step += this->Stride)
+    steps.push_back(step);
+  return steps;
+}
+
+}
+} //xenia::utils
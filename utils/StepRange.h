@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <vtkm/Types.h>
+#include <boost/program_options.hpp>
+
+namespace xenia
+{
+namespace utils
+{
+
+// Steps selected with start:stop:stride, like a python slice. stop is not included.
+// Empty parts use the defaults, e.g. "::10" is every 10th step and "100:" is step 100 on.
+// A single number selects one step.
+class StepRange
+{
+  public:
+  StepRange() = default;
+  StepRange(const std::string& range);
+  //The range in option name, or every step when it is not given.
+  StepRange(const boost::program_options::variables_map& vm, const std::string& name);
+
+  vtkm::Id GetStart() const { return this->Start; }
+  vtkm::Id GetStride() const { return this->Stride; }
+  bool IsAll() const { return this->Start == 0 && this->Stop < 0 && this->Stride == 1; }
+
+  bool Contains(vtkm::Id step) const;
+  //No step at or after step is selected.
+  bool IsPast(vtkm::Id step) const { return this->Stop >= 0 && step >= this->Stop; }
+  //The selected steps below numSteps.
+  std::vector<vtkm::Id> GetSteps(vtkm::Id numSteps) const;
+
+  private:
+  vtkm::Id Start = 0;
+  vtkm::Id Stop = -1; //negative is no end.
+  vtkm::Id Stride = 1;
+};
+
+}
+} //xenia::utils
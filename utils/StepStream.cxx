@@ -0,0 +1,123 @@
+#include "StepStream.h"
+
+#include <chrono>
+#include <future>
+#include <thread>
+#include <iostream>
+
+#ifdef ENABLE_MPI
+#include <mpi.h>
+#endif
+
+namespace xenia
+{
+namespace utils
+{
+
+StepStream::StepStream(DataSetReader& source, DataSetWriter& sink)
+  : Source(source)
+  , Sink(sink)
+{
+#ifdef ENABLE_MPI
+  MPI_Comm_rank(MPI_COMM_WORLD, &this->Rank);
+#endif
+}
+
+void
+StepStream::SetPrefetch(bool val)
+{
+  this->Prefetch = val;
+
+#ifdef ENABLE_MPI
+  //The reads on the prefetch thread make MPI calls (through ADIOS) while the service may also be
+  //making MPI calls on the main thread.
+  if (this->Prefetch)
+  {
+    int provided = MPI_THREAD_SINGLE;
+    MPI_Query_thread(&provided);
+    if (provided < MPI_THREAD_MULTIPLE)
+    {
+      if (this->Rank == 0)
+        std::cerr<<"Warning: MPI_THREAD_MULTIPLE not supported. Prefetch disabled."<<std::endl;
+      this->Prefetch = false;
+    }
+  }
+#endif
+}
+
+StepStream::StepData
+StepStream::ReadNextStep()
+{
+  StepData data;
+
+  //BeginStep waits until the step is ready, or the stream ends. Steps that are not selected are skipped.
+  auto start = std::chrono::steady_clock::now();
+  data.Status = this->Source.BeginStep();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  data.Step = this->Source.GetStep();
+
+  if (data.Status == fides::StepStatus::OK)
+  {
+    if (this->Timer)
+      this->Timer->Record(data.Step, "begin_step", elapsed.count());
+
+    start = std::chrono::steady_clock::now();
+    data.Data = this->Source.Read();
+    data.BlockIDs = this->Source.GetReadBlockIDs();
+    this->Source.EndStep();
+    elapsed = std::chrono::steady_clock::now() - start;
+    if (this->Timer)
+      this->Timer->Record(data.Step, "read", elapsed.count());
+  }
+
+  return data;
+}
+
+vtkm::Id
+StepStream::Run(const ServiceFunction& service)
+{
+  //A deferred future runs the read on the calling thread when get() is called.
+  auto policy = (this->Prefetch ? std::launch::async : std::launch::deferred);
+  auto readStep = [this]() { return this->ReadNextStep(); };
+
+  vtkm::Id numSteps = 0;
+  std::future<StepData> next = std::async(policy, readStep);
+  while (true)
+  {
+    StepData current = next.get();
+    if (current.Status == fides::StepStatus::EndOfStream)
+      break;
+    else if (current.Status != fides::StepStatus::OK)
+      throw std::runtime_error("Unexpected step status.");
+
+    //Start reading the next step while this one is processed.
+    next = std::async(policy, readStep);
+
+    if (this->SleepTime > 0)
+      std::this_thread::sleep_for(std::chrono::seconds(this->SleepTime));
+
+    this->BlockIDs = current.BlockIDs;
+    auto start = std::chrono::steady_clock::now();
+    auto output = service(current.Step, current.Data);
+    std::chrono::duration<double> serviceTime = std::chrono::steady_clock::now() - start;
+    this->Source.RecordStepCost(current.BlockIDs, serviceTime.count());
+
+    if (this->Sink.IsStepSelected(current.Step) &&
+        (output.GetNumberOfPartitions() > 0 || this->Sink.GetWritesCollective()))
+    {
+      start = std::chrono::steady_clock::now();
+      this->Sink.BeginStep(current.Step);
+      this->Sink.WriteDataSet(output);
+      this->Sink.EndStep();
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      if (this->Timer)
+        this->Timer->Record(current.Step, "write", elapsed.count());
+    }
+    numSteps++;
+  }
+
+  return numSteps;
+}
+
+}
+} //xenia::utils
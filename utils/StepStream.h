@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+
+#include <vtkm/cont/PartitionedDataSet.h>
+#include <fides/DataSetReader.h>
+
+#include "ReadData.h"
+#include "Timing.h"
+#include "WriteData.h"
+
+namespace xenia
+{
+namespace utils
+{
+
+// Drives a service over a stream of steps.
+// The DataSetReader is the step source (BPFile or SST) and the DataSetWriter is the step sink.
+// With prefetch enabled, step N+1 is read on a background thread while the service runs on step N.
+class StepStream
+{
+  public:
+  using ServiceFunction =
+    std::function<vtkm::cont::PartitionedDataSet(vtkm::Id, const vtkm::cont::PartitionedDataSet&)>;
+
+  StepStream(DataSetReader& source, DataSetWriter& sink);
+
+  void SetPrefetch(bool val);
+  bool GetPrefetch() const { return this->Prefetch; }
+
+  //Times the begin step (includes waiting on a stream), read and write stages of each step.
+  void SetTimer(StepTimer* timer) { this->Timer = timer; }
+
+  //Seconds to sleep before the service runs on each step. Not counted in the service time.
+  void SetSleepTime(int seconds) { this->SleepTime = seconds; }
+
+  vtkm::Id Run(const ServiceFunction& service);
+
+  //Global block id of each partition of the step the service is running on (see DataSetReader::GetReadBlockIDs).
+  const std::vector<vtkm::Id>& GetBlockIDs() const { return this->BlockIDs; }
+
+  private:
+  struct StepData
+  {
+    fides::StepStatus Status = fides::StepStatus::EndOfStream;
+    vtkm::Id Step = 0;
+    vtkm::cont::PartitionedDataSet Data;
+    std::vector<vtkm::Id> BlockIDs;
+  };
+
+  StepData ReadNextStep();
+
+  DataSetReader& Source;
+  DataSetWriter& Sink;
+  bool Prefetch = false;
+  StepTimer* Timer = nullptr;
+  int SleepTime = 0;
+  std::vector<vtkm::Id> BlockIDs;
+  int Rank = 0;
+};
+
+}
+} //xenia::utils
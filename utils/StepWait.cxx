@@ -0,0 +1,71 @@
+#include "StepWait.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace xenia
+{
+namespace utils
+{
+
+StepWaitPolicy::StepWaitPolicy(const boost::program_options::variables_map& vm)
+{
+  if (!vm["step-timeout"].empty())
+    this->Timeout = vm["step-timeout"].as<double>();
+  if (!vm["step-backoff-max"].empty())
+    this->MaxBackoff = vm["step-backoff-max"].as<double>();
+
+  if (this->MaxBackoff < this->MinBackoff)
+    this->MaxBackoff = this->MinBackoff;
+}
+
+fides::StepStatus
+StepWaitPolicy::Wait(const std::function<fides::StepStatus()>& prepareStep)
+{
+  using Clock = std::chrono::steady_clock;
+
+  auto start = Clock::now();
+  double backoff = this->MinBackoff;
+  bool waited = false;
+
+  fides::StepStatus status = prepareStep();
+  while (status == fides::StepStatus::NotReady)
+  {
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    if (this->Timeout >= 0.0 && elapsed >= this->Timeout)
+    {
+      this->WaitTime += elapsed;
+      throw std::runtime_error("Error: Timed out after " + std::to_string(elapsed) +
+                               " seconds waiting for the next step.");
+    }
+
+    double sleepTime = backoff;
+    if (this->Timeout >= 0.0)
+      sleepTime = std::min(sleepTime, this->Timeout - elapsed);
+    std::this_thread::sleep_for(std::chrono::duration<double>(sleepTime));
+
+    backoff = std::min(2.0 * backoff, this->MaxBackoff);
+    waited = true;
+    status = prepareStep();
+  }
+
+  if (waited)
+  {
+    this->WaitTime += std::chrono::duration<double>(Clock::now() - start).count();
+    this->NumWaits++;
+  }
+  if (status == fides::StepStatus::OK)
+    this->NumSteps++;
+
+  return status;
+}
+
+void
+StepWaitPolicy::PrintSummary(std::ostream& out) const
+{
+  out<<"Waited "<<this->WaitTime<<" seconds for "<<this->NumWaits<<" of "<<this->NumSteps<<" steps."<<std::endl;
+}
+
+}
+} //xenia::utils
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <functional>
+#include <iostream>
+
+#include <vtkm/Types.h>
+#include <fides/DataSetReader.h>
+#include <boost/program_options.hpp>
+
+namespace xenia
+{
+namespace utils
+{
+
+// Waits for the next step of a stream to become ready.
+// Instead of spinning on NotReady, the wait sleeps with an exponential backoff and gives up
+// after an optional timeout. The time spent waiting is accumulated so it can be reported.
+class StepWaitPolicy
+{
+  public:
+  StepWaitPolicy() = default;
+  StepWaitPolicy(const boost::program_options::variables_map& vm);
+
+  //Calls prepareStep until it returns something other than NotReady.
+  fides::StepStatus Wait(const std::function<fides::StepStatus()>& prepareStep);
+
+  double GetWaitTime() const { return this->WaitTime; }
+  vtkm::Id GetNumberOfWaits() const { return this->NumWaits; }
+  void PrintSummary(std::ostream& out) const;
+
+  private:
+  double Timeout = -1.0; //seconds, negative waits forever.
+  double MinBackoff = 0.001;
+  double MaxBackoff = 1.0;
+
+  double WaitTime = 0.0;
+  vtkm::Id NumWaits = 0;
+  vtkm::Id NumSteps = 0;
+};
+
+}
+} //xenia::utils
@@ -0,0 +1,458 @@
+#include "Streamline.h"
+
+#include <vtkm/CellShape.h>
+#include <vtkm/Math.h>
+#include <vtkm/VecFromPortalPermute.h>
+#include <vtkm/VectorAnalysis.h>
+#include <vtkm/cont/Algorithm.h>
+#include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandleConstant.h>
+#include <vtkm/cont/ArrayHandleIndex.h>
+#include <vtkm/cont/CastAndCall.h>
+#include <vtkm/cont/CellLocatorGeneral.h>
+#include <vtkm/cont/CellSetExplicit.h>
+#include <vtkm/cont/ConvertNumComponentsToOffsets.h>
+#include <vtkm/cont/DataSet.h>
+#include <vtkm/cont/Invoker.h>
+#include <vtkm/exec/CellInterpolate.h>
+#include <vtkm/worklet/WorkletMapField.h>
+#include <vtkm/worklet/WorkletMapTopology.h>
+
+namespace xenia
+{
+namespace utils
+{
+
+namespace
+{
+
+constexpr vtkm::UInt8 PARTICLE_ACTIVE = 0;
+constexpr vtkm::UInt8 PARTICLE_DONE = 1;
+
+//Advance each particle through one block with RK45 steps. The particle stops at the end of the block,
+//after NumberOfSteps steps, or where the field is zero.
+//Each particle writes its points (and their times) to its own MaxSteps+1 slots of points, and marks them in valid.
+class RKF45Worklet : public vtkm::worklet::WorkletMapField
+{
+  public:
+  using ControlSignature = void(FieldInOut position,
+                                FieldInOut time,
+                                FieldInOut stepSize,
+                                FieldInOut numSteps,
+                                FieldInOut status,
+                                FieldOut numPoints,
+                                ExecObject locator,
+                                WholeCellSetIn<> cellSet,
+                                WholeArrayIn field,
+                                WholeArrayOut points,
+                                WholeArrayOut times,
+                                WholeArrayOut valid);
+  using ExecutionSignature = void(WorkIndex, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12);
+
+  RKF45Worklet(vtkm::Id maxSteps, vtkm::FloatDefault minStepSize, vtkm::FloatDefault maxStepSize, vtkm::FloatDefault tolerance)
+    : MaxSteps(maxSteps)
+    , MinStepSize(minStepSize)
+    , MaxStepSize(maxStepSize)
+    , Tolerance(tolerance)
+  {
+  }
+
+  template <typename LocatorType,
+            typename CellSetType,
+            typename FieldPortal,
+            typename PointPortal,
+            typename TimePortal,
+            typename ValidPortal>
+  VTKM_EXEC void operator()(vtkm::Id index,
+                            vtkm::Vec3f& position,
+                            vtkm::FloatDefault& time,
+                            vtkm::FloatDefault& stepSize,
+                            vtkm::Id& numSteps,
+                            vtkm::UInt8& status,
+                            vtkm::Id& numPoints,
+                            const LocatorType& locator,
+                            const CellSetType& cellSet,
+                            const FieldPortal& field,
+                            const PointPortal& points,
+                            const TimePortal& times,
+                            const ValidPortal& valid) const
+  {
+    using T = vtkm::FloatDefault;
+    numPoints = 0;
+    vtkm::Vec3f k1;
+    if (status != PARTICLE_ACTIVE || !this->Evaluate(position, locator, cellSet, field, k1))
+      return;
+
+    vtkm::Id offset = index * (this->MaxSteps + 1);
+    points.Set(offset, position);
+    times.Set(offset, time);
+    valid.Set(offset, 1);
+    numPoints = 1;
+
+    while (numSteps < this->MaxSteps)
+    {
+      if (vtkm::MagnitudeSquared(k1) == 0)
+      {
+        status = PARTICLE_DONE;
+        break;
+      }
+
+      vtkm::Vec3f next, nextK1;
+      vtkm::FloatDefault error = 0;
+      bool inside = this->Step(position, k1, stepSize, locator, cellSet, field, next, error);
+
+      if (inside && error > this->Tolerance && stepSize > this->MinStepSize)
+      {
+        T scale = vtkm::Max(T(0.9) * vtkm::Pow(this->Tolerance / error, T(0.25)), T(0.1));
+        stepSize = vtkm::Max(stepSize * scale, this->MinStepSize);
+        continue;
+      }
+
+      if (inside && this->Evaluate(next, locator, cellSet, field, nextK1))
+      {
+        position = next;
+        time += stepSize;
+        numSteps++;
+        points.Set(offset + numPoints, position);
+        times.Set(offset + numPoints, time);
+        valid.Set(offset + numPoints, 1);
+        numPoints++;
+        k1 = nextK1;
+
+        T scale = T(5);
+        if (error > 0)
+          scale = vtkm::Min(vtkm::Max(T(0.9) * vtkm::Pow(this->Tolerance / error, T(0.2)), T(0.2)), T(5));
+        stepSize = vtkm::Min(vtkm::Max(stepSize * scale, this->MinStepSize), this->MaxStepSize);
+        continue;
+      }
+
+      //Part of the step is outside the block. Get closer to the boundary.
+      if (stepSize > this->MinStepSize)
+      {
+        stepSize = vtkm::Max(stepSize * T(0.5), this->MinStepSize);
+        continue;
+      }
+
+      //Step out of the block so the particle is found in the next one.
+      position = position + stepSize * k1;
+      time += stepSize;
+      numSteps++;
+      points.Set(offset + numPoints, position);
+      times.Set(offset + numPoints, time);
+      valid.Set(offset + numPoints, 1);
+      numPoints++;
+      break;
+    }
+
+    if (numSteps >= this->MaxSteps)
+      status = PARTICLE_DONE;
+
+    //A single point is not a line.
+    if (numPoints < 2)
+    {
+      valid.Set(offset, 0);
+      numPoints = 0;
+    }
+  }
+
+  private:
+  template <typename LocatorType, typename CellSetType, typename FieldPortal>
+  VTKM_EXEC bool Evaluate(const vtkm::Vec3f& point,
+                          const LocatorType& locator,
+                          const CellSetType& cellSet,
+                          const FieldPortal& field,
+                          vtkm::Vec3f& velocity) const
+  {
+    vtkm::Id cellId;
+    vtkm::Vec3f pcoords;
+    if (locator.FindCell(point, cellId, pcoords) != vtkm::ErrorCode::Success)
+      return false;
+
+    auto indices = cellSet.GetIndices(cellId);
+    auto values = vtkm::make_VecFromPortalPermute(&indices, field);
+    return vtkm::exec::CellInterpolate(values, pcoords, cellSet.GetCellShape(cellId), velocity) == vtkm::ErrorCode::Success;
+  }
+
+  //One Fehlberg step. next is the 5th order position, error is its distance from the 4th order position.
+  //Returns false if a stage falls outside the block.
+  template <typename LocatorType, typename CellSetType, typename FieldPortal>
+  VTKM_EXEC bool Step(const vtkm::Vec3f& y,
+                      const vtkm::Vec3f& k1,
+                      vtkm::FloatDefault h,
+                      const LocatorType& locator,
+                      const CellSetType& cellSet,
+                      const FieldPortal& field,
+                      vtkm::Vec3f& next,
+                      vtkm::FloatDefault& error) const
+  {
+    using T = vtkm::FloatDefault;
+    vtkm::Vec3f k2, k3, k4, k5, k6;
+    if (!this->Evaluate(y + h * (T(1.0/4.0) * k1), locator, cellSet, field, k2))
+      return false;
+    if (!this->Evaluate(y + h * (T(3.0/32.0) * k1 + T(9.0/32.0) * k2), locator, cellSet, field, k3))
+      return false;
+    if (!this->Evaluate(y + h * (T(1932.0/2197.0) * k1 - T(7200.0/2197.0) * k2 + T(7296.0/2197.0) * k3),
+                        locator, cellSet, field, k4))
+      return false;
+    if (!this->Evaluate(y + h * (T(439.0/216.0) * k1 - T(8) * k2 + T(3680.0/513.0) * k3 - T(845.0/4104.0) * k4),
+                        locator, cellSet, field, k5))
+      return false;
+    if (!this->Evaluate(y + h * (-T(8.0/27.0) * k1 + T(2) * k2 - T(3544.0/2565.0) * k3 + T(1859.0/4104.0) * k4 - T(11.0/40.0) * k5),
+                        locator, cellSet, field, k6))
+      return false;
+
+    vtkm::Vec3f y4 = y + h * (T(25.0/216.0) * k1 + T(1408.0/2565.0) * k3 + T(2197.0/4104.0) * k4 - T(1.0/5.0) * k5);
+    next = y + h * (T(16.0/135.0) * k1 + T(6656.0/12825.0) * k3 + T(28561.0/56430.0) * k4 - T(9.0/50.0) * k5 + T(2.0/55.0) * k6);
+    error = vtkm::Magnitude(next - y4);
+    return true;
+  }
+
+  vtkm::Id MaxSteps;
+  vtkm::FloatDefault MinStepSize;
+  vtkm::FloatDefault MaxStepSize;
+  vtkm::FloatDefault Tolerance;
+};
+
+class LineAttributesWorklet : public vtkm::worklet::WorkletVisitCellsWithPoints
+{
+  public:
+  using ControlSignature = void(CellSetIn cellSet,
+                                FieldInCell seedID,
+                                WholeArrayIn coords,
+                                WholeArrayIn inTimes,
+                                WholeArrayOut seedIDs,
+                                WholeArrayInOut arcLength,
+                                WholeArrayInOut times,
+                                WholeArrayOut speed);
+  using ExecutionSignature = void(PointIndices, _2, _3, _4, _5, _6, _7, _8);
+
+  LineAttributesWorklet(bool hasTime, vtkm::FloatDefault stepSize)
+    : HasTime(hasTime)
+    , StepSize(stepSize)
+  {
+  }
+
+  template <typename IndicesType,
+            typename CoordsPortal,
+            typename InTimePortal,
+            typename SeedPortal,
+            typename FloatPortal>
+  VTKM_EXEC void operator()(const IndicesType& indices,
+                            vtkm::Id seedID,
+                            const CoordsPortal& coords,
+                            const InTimePortal& inTimes,
+                            const SeedPortal& seedIDs,
+                            const FloatPortal& arcLength,
+                            const FloatPortal& times,
+                            const FloatPortal& speed) const
+  {
+    vtkm::IdComponent n = indices.GetNumberOfComponents();
+    vtkm::FloatDefault length = 0;
+    for (vtkm::IdComponent k = 0; k < n; k++)
+    {
+      vtkm::Id idx = indices[k];
+      if (k > 0)
+        length += static_cast<vtkm::FloatDefault>(vtkm::Magnitude(coords.Get(idx) - coords.Get(indices[k-1])));
+      seedIDs.Set(idx, seedID);
+      arcLength.Set(idx, length);
+      times.Set(idx, this->HasTime ? inTimes.Get(idx) : static_cast<vtkm::FloatDefault>(k) * this->StepSize);
+    }
+
+    for (vtkm::IdComponent k = 0; k < n; k++)
+    {
+      vtkm::Id idx = indices[k];
+      if (length > 0)
+        arcLength.Set(idx, arcLength.Get(idx) / length);
+
+      vtkm::FloatDefault v = 0;
+      if (n > 1)
+      {
+        vtkm::IdComponent a = (k < n-1 ? k : k-1);
+        vtkm::Id i0 = indices[a], i1 = indices[a+1];
+        vtkm::FloatDefault dt = times.Get(i1) - times.Get(i0);
+        if (dt > 0)
+          v = static_cast<vtkm::FloatDefault>(vtkm::Magnitude(coords.Get(i1) - coords.Get(i0))) / dt;
+      }
+      speed.Set(idx, v);
+    }
+  }
+
+  private:
+  bool HasTime;
+  vtkm::FloatDefault StepSize;
+};
+
+vtkm::cont::DataSet
+MakePolyLines(const vtkm::cont::ArrayHandle<vtkm::Vec3f>& points,
+              const vtkm::cont::ArrayHandle<vtkm::Id>& counts)
+{
+  vtkm::Id numPoints = points.GetNumberOfValues();
+  vtkm::Id numCells = counts.GetNumberOfValues();
+
+  vtkm::cont::ArrayHandle<vtkm::Id> offsets, connectivity;
+  vtkm::cont::ArrayHandle<vtkm::UInt8> shapes;
+  vtkm::cont::ConvertNumComponentsToOffsets(counts, offsets);
+  vtkm::cont::ArrayCopy(vtkm::cont::ArrayHandleIndex(numPoints), connectivity);
+  vtkm::cont::ArrayCopy(vtkm::cont::make_ArrayHandleConstant(vtkm::UInt8(vtkm::CELL_SHAPE_POLY_LINE), numCells), shapes);
+
+  vtkm::cont::CellSetExplicit<> cellSet;
+  cellSet.Fill(numPoints, shapes, connectivity, offsets);
+
+  vtkm::cont::DataSet ds;
+  ds.SetCellSet(cellSet);
+  ds.AddCoordinateSystem(vtkm::cont::CoordinateSystem("coordinates", points));
+  return ds;
+}
+
+}
+
+vtkm::cont::PartitionedDataSet
+AdaptiveStreamline::Execute(const vtkm::cont::PartitionedDataSet& input) const
+{
+  vtkm::Id numSeeds = static_cast<vtkm::Id>(this->Seeds.size());
+  std::vector<vtkm::Vec3f> seedPositions;
+  std::vector<vtkm::Id> seedIDs;
+  seedPositions.reserve(this->Seeds.size());
+  seedIDs.reserve(this->Seeds.size());
+  for (const auto& seed : this->Seeds)
+  {
+    seedPositions.push_back(seed.GetPosition());
+    seedIDs.push_back(seed.GetID());
+  }
+
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> position = vtkm::cont::make_ArrayHandle(seedPositions, vtkm::CopyFlag::On);
+  vtkm::cont::ArrayHandle<vtkm::Id> seedID = vtkm::cont::make_ArrayHandle(seedIDs, vtkm::CopyFlag::On);
+  vtkm::cont::ArrayHandle<vtkm::FloatDefault> time, stepSize;
+  vtkm::cont::ArrayHandle<vtkm::Id> numSteps;
+  vtkm::cont::ArrayHandle<vtkm::UInt8> status;
+  time.AllocateAndFill(numSeeds, 0);
+  stepSize.AllocateAndFill(numSeeds, this->StepSize);
+  numSteps.AllocateAndFill(numSeeds, 0);
+  status.AllocateAndFill(numSeeds, PARTICLE_ACTIVE);
+
+  RKF45Worklet worklet(this->NumberOfSteps, this->MinStepSize, this->MaxStepSize, this->Tolerance);
+  vtkm::cont::Invoker invoke;
+  vtkm::Id bufferSize = numSeeds * (this->NumberOfSteps + 1);
+
+  //The locators and fields of the blocks, built once for all the passes.
+  struct BlockData
+  {
+    vtkm::cont::DataSet DataSet;
+    vtkm::cont::ArrayHandle<vtkm::Vec3f> Field;
+    vtkm::cont::CellLocatorGeneral Locator;
+  };
+  std::vector<BlockData> blocks;
+  for (const auto& ds : input)
+  {
+    if (!ds.HasPointField(this->FieldName))
+      continue;
+
+    BlockData block;
+    block.DataSet = ds;
+    vtkm::cont::ArrayCopyShallowIfPossible(ds.GetPointField(this->FieldName).GetData(), block.Field);
+    block.Locator.SetCellSet(ds.GetCellSet());
+    block.Locator.SetCoordinates(ds.GetCoordinateSystem());
+    block.Locator.Update();
+    blocks.push_back(block);
+  }
+
+  //Step buffers, reused for every block and pass.
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> points;
+  vtkm::cont::ArrayHandle<vtkm::FloatDefault> times;
+  vtkm::cont::ArrayHandle<vtkm::UInt8> valid;
+  vtkm::cont::ArrayHandle<vtkm::Id> numPoints;
+  points.Allocate(bufferSize);
+  times.Allocate(bufferSize);
+  valid.Allocate(bufferSize);
+
+  //Blocks are visited until no particle moves. A particle that leaves a block is picked up by the block it enters.
+  vtkm::cont::PartitionedDataSet output;
+  bool moved = true;
+  for (vtkm::Id pass = 0; moved && pass < this->NumberOfSteps; pass++)
+  {
+    moved = false;
+    for (auto& block : blocks)
+    {
+      valid.Fill(0);
+      vtkm::cont::CastAndCall(block.DataSet.GetCellSet(), [&](const auto& cellSet) {
+        invoke(worklet, position, time, stepSize, numSteps, status, numPoints, block.Locator, cellSet, block.Field, points, times, valid);
+      });
+
+      if (vtkm::cont::Algorithm::Reduce(numPoints, vtkm::Id(0)) == 0)
+        continue;
+      moved = true;
+
+      vtkm::cont::ArrayHandle<vtkm::Vec3f> linePoints;
+      vtkm::cont::ArrayHandle<vtkm::FloatDefault> lineTimes;
+      vtkm::cont::ArrayHandle<vtkm::Id> lineCounts, lineSeedIDs;
+      vtkm::cont::Algorithm::CopyIf(points, valid, linePoints);
+      vtkm::cont::Algorithm::CopyIf(times, valid, lineTimes);
+      vtkm::cont::Algorithm::CopyIf(numPoints, numPoints, lineCounts);
+      vtkm::cont::Algorithm::CopyIf(seedID, numPoints, lineSeedIDs);
+
+      auto lines = MakePolyLines(linePoints, lineCounts);
+      lines.AddPointField("Time", lineTimes);
+      lines.AddCellField("SeedID", lineSeedIDs);
+      output.AppendPartition(lines);
+    }
+  }
+
+  return output;
+}
+
+vtkm::cont::DataSet
+AddStreamlineAttributes(const vtkm::cont::DataSet& ds, vtkm::FloatDefault stepSize)
+{
+  vtkm::Id numPoints = ds.GetNumberOfPoints();
+  vtkm::Id numCells = ds.GetNumberOfCells();
+
+  vtkm::cont::ArrayHandle<vtkm::Vec3f> coords;
+  vtkm::cont::ArrayCopyShallowIfPossible(ds.GetCoordinateSystem().GetData(), coords);
+
+  vtkm::cont::ArrayHandle<vtkm::Id> lineSeedIDs;
+  bool hasSeedIDs = ds.HasCellField("SeedID");
+  if (hasSeedIDs)
+    vtkm::cont::ArrayCopyShallowIfPossible(ds.GetCellField("SeedID").GetData(), lineSeedIDs);
+  else
+    vtkm::cont::ArrayCopy(vtkm::cont::ArrayHandleIndex(numCells), lineSeedIDs);
+
+  bool hasTime = ds.HasPointField("Time");
+  vtkm::cont::ArrayHandle<vtkm::FloatDefault> inTimes;
+  if (hasTime)
+    vtkm::cont::ArrayCopyShallowIfPossible(ds.GetPointField("Time").GetData(), inTimes);
+
+  vtkm::cont::ArrayHandle<vtkm::Id> seedIDs;
+  vtkm::cont::ArrayHandle<vtkm::FloatDefault> arcLength, times, speed;
+  seedIDs.AllocateAndFill(numPoints, -1);
+  arcLength.AllocateAndFill(numPoints, 0);
+  times.AllocateAndFill(numPoints, 0);
+  speed.AllocateAndFill(numPoints, 0);
+
+  vtkm::cont::Invoker invoke;
+  LineAttributesWorklet worklet(hasTime, stepSize);
+  vtkm::cont::CastAndCall(ds.GetCellSet(), [&](const auto& cellSet) {
+    invoke(worklet, cellSet, lineSeedIDs, coords, inTimes, seedIDs, arcLength, times, speed);
+  });
+
+  //The point attributes replace the line seed ids and times.
+  vtkm::cont::DataSet output;
+  output.SetCellSet(ds.GetCellSet());
+  for (vtkm::IdComponent i = 0; i < ds.GetNumberOfCoordinateSystems(); i++)
+    output.AddCoordinateSystem(ds.GetCoordinateSystem(i));
+  for (vtkm::IdComponent i = 0; i < ds.GetNumberOfFields(); i++)
+  {
+    const auto& field = ds.GetField(i);
+    if (field.GetName() != "SeedID" && field.GetName() != "Time" && !ds.HasCoordinateSystem(field.GetName()))
+      output.AddField(field);
+  }
+  //Without seed ids the line index is only unique in this partition, so it is not called SeedID.
+  output.AddPointField(hasSeedIDs ? "SeedID" : "LineIndex", seedIDs);
+  output.AddPointField("ArcLength", arcLength);
+  output.AddPointField("Time", times);
+  output.AddPointField("Speed", speed);
+
+  return output;
+}
+
+}
+} //xenia::utils
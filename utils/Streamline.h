@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <vtkm/Particle.h>
+#include <vtkm/cont/DataSet.h>
+#include <vtkm/cont/PartitionedDataSet.h>
+
+namespace xenia
+{
+namespace utils
+{
+
+// Streamlines traced with an adaptive Runge-Kutta-Fehlberg (RK45) integrator.
+// Each step compares the 4th and 5th order solutions. When the difference is above the tolerance the step is
+// retried with a smaller step size, and where the field is smooth the step size grows, within [min, max].
+// Particles are traced through the blocks of this rank. Each block a streamline crosses gives one polyline.
+// The lines have a "Time" point field and a "SeedID" cell field.
+class AdaptiveStreamline
+{
+  public:
+  void SetActiveField(const std::string& name) { this->FieldName = name; }
+  void SetSeeds(const std::vector<vtkm::Particle>& seeds) { this->Seeds = seeds; }
+  void SetNumberOfSteps(vtkm::Id numSteps) { this->NumberOfSteps = numSteps; }
+  //Initial step size.
+  void SetStepSize(vtkm::FloatDefault stepSize) { this->StepSize = stepSize; }
+  void SetStepSizeRange(vtkm::FloatDefault minStepSize, vtkm::FloatDefault maxStepSize)
+  {
+    this->MinStepSize = minStepSize;
+    this->MaxStepSize = maxStepSize;
+  }
+  //Largest accepted difference between the 4th and 5th order positions in one step.
+  void SetTolerance(vtkm::FloatDefault tolerance) { this->Tolerance = tolerance; }
+
+  vtkm::cont::PartitionedDataSet Execute(const vtkm::cont::PartitionedDataSet& input) const;
+
+  private:
+  std::string FieldName;
+  std::vector<vtkm::Particle> Seeds;
+  vtkm::Id NumberOfSteps = 1000;
+  vtkm::FloatDefault StepSize = 0.01f;
+  vtkm::FloatDefault MinStepSize = 0.0001f;
+  vtkm::FloatDefault MaxStepSize = 1.0f;
+  vtkm::FloatDefault Tolerance = 1e-5f;
+};
+
+// Per point attributes of polyline streamlines, computed on the device with one thread per line:
+//  SeedID     id of the seed of the line, from the "SeedID" cell field. Without it, LineIndex, the index of
+//             the line in the partition, is added instead.
+//  ArcLength  distance along the line, normalized to [0, 1].
+//  Time       integration time. The "Time" point field if there is one, otherwise point index * stepSize.
+//  Speed      distance over time to the next point (the previous point for the last one).
+vtkm::cont::DataSet AddStreamlineAttributes(const vtkm::cont::DataSet& ds, vtkm::FloatDefault stepSize);
+
+}
+} //xenia::utils
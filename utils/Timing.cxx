@@ -0,0 +1,169 @@
+#include "Timing.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+
+namespace xenia
+{
+namespace utils
+{
+
+StepTimer::StepTimer(const boost::program_options::variables_map& vm)
+{
+#ifdef ENABLE_MPI
+  MPI_Comm_rank(MPI_COMM_WORLD, &this->Rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &this->NumRanks);
+#endif
+
+  if (!vm["timing"].empty())
+  {
+    this->OutputFileName = vm["timing"].as<std::string>();
+    if (this->OutputFileName.find(".csv") == std::string::npos &&
+        this->OutputFileName.find(".json") == std::string::npos)
+      throw std::runtime_error("Error. Timing output must be a .csv or .json file: " + this->OutputFileName);
+  }
+  this->Summary = (vm.count("timing-summary") > 0);
+}
+
+void
+StepTimer::Record(vtkm::Id step, const std::string& stage, double seconds)
+{
+  if (!this->GetEnabled())
+    return;
+
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->Entries.push_back({step, stage, seconds});
+}
+
+void
+StepTimer::Finish() const
+{
+  if (!this->OutputFileName.empty())
+    this->WriteRecords();
+  if (this->Summary)
+    this->WriteSummary();
+}
+
+std::string
+StepTimer::GetRankFileName() const
+{
+  if (this->NumRanks == 1)
+    return this->OutputFileName;
+
+  //timing.csv --> timing.<rank>.csv
+  auto fname = this->OutputFileName;
+  auto pos = fname.rfind('.');
+  fname.insert(pos, "." + std::to_string(this->Rank));
+  return fname;
+}
+
+void
+StepTimer::WriteRecords() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+
+  std::ofstream fout(this->GetRankFileName());
+  fout<<std::setprecision(9);
+  if (this->OutputFileName.find(".json") != std::string::npos)
+  {
+    fout<<"{\"rank\": "<<this->Rank<<", \"records\": ["<<std::endl;
+    for (std::size_t i = 0; i < this->Entries.size(); i++)
+    {
+      const auto& e = this->Entries[i];
+      fout<<"  {\"step\": "<<e.Step<<", \"stage\": \""<<e.Stage<<"\", \"seconds\": "<<e.Seconds<<"}";
+      fout<<(i+1 < this->Entries.size() ? "," : "")<<std::endl;
+    }
+    fout<<"]}"<<std::endl;
+  }
+  else
+  {
+    fout<<"rank,step,stage,seconds"<<std::endl;
+    for (const auto& e : this->Entries)
+      fout<<this->Rank<<","<<e.Step<<","<<e.Stage<<","<<e.Seconds<<std::endl;
+  }
+}
+
+void
+StepTimer::WriteSummary() const
+{
+  //Total time in each stage on this rank.
+  std::map<std::string, double> totals;
+  std::set<vtkm::Id> steps;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    for (const auto& e : this->Entries)
+    {
+      totals[e.Stage] += e.Seconds;
+      steps.insert(e.Step);
+    }
+  }
+
+  //Steps that were timed. With --steps these are not 0..N-1.
+  long long numSteps = static_cast<long long>(steps.size());
+#ifdef ENABLE_MPI
+  MPI_Allreduce(MPI_IN_PLACE, &numSteps, 1, MPI_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+#endif
+
+  //Use the stage names from rank 0 so that every rank reduces the same list.
+  std::string names;
+  for (const auto& it : totals)
+    names += it.first + "\n";
+#ifdef ENABLE_MPI
+  int len = static_cast<int>(names.size());
+  MPI_Bcast(&len, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  names.resize(len);
+  MPI_Bcast(&names[0], len, MPI_CHAR, 0, MPI_COMM_WORLD);
+#endif
+
+  std::vector<std::string> stages;
+  std::istringstream stream(names);
+  std::string stage;
+  while (std::getline(stream, stage))
+    stages.push_back(stage);
+
+  int n = static_cast<int>(stages.size());
+  std::vector<double> minVals(n), maxVals(n), sumVals(n);
+  for (int i = 0; i < n; i++)
+  {
+    auto it = totals.find(stages[i]);
+    minVals[i] = maxVals[i] = sumVals[i] = (it == totals.end() ? 0.0 : it->second);
+  }
+
+#ifdef ENABLE_MPI
+  if (this->Rank == 0)
+  {
+    MPI_Reduce(MPI_IN_PLACE, minVals.data(), n, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+    MPI_Reduce(MPI_IN_PLACE, maxVals.data(), n, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(MPI_IN_PLACE, sumVals.data(), n, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  }
+  else
+  {
+    MPI_Reduce(minVals.data(), nullptr, n, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+    MPI_Reduce(maxVals.data(), nullptr, n, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(sumVals.data(), nullptr, n, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  }
+#endif
+
+  if (this->Rank != 0)
+    return;
+
+  std::cout<<"Timing summary: "<<numSteps<<" steps on "<<this->NumRanks<<" ranks (seconds)"<<std::endl;
+  std::cout<<std::left<<std::setw(16)<<"stage"<<std::right<<std::setw(12)<<"min"<<std::setw(12)<<"max"
+           <<std::setw(12)<<"avg"<<std::setw(12)<<"avg/step"<<std::endl;
+  for (int i = 0; i < n; i++)
+  {
+    double avg = sumVals[i] / this->NumRanks;
+    std::cout<<std::left<<std::setw(16)<<stages[i]<<std::right<<std::fixed<<std::setprecision(4)
+             <<std::setw(12)<<minVals[i]<<std::setw(12)<<maxVals[i]<<std::setw(12)<<avg
+             <<std::setw(12)<<(numSteps > 0 ? avg / numSteps : 0.0)<<std::endl;
+  }
+  std::cout.unsetf(std::ios::fixed);
+}
+
+}
+} //xenia::utils
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <vtkm/Types.h>
+#include <boost/program_options.hpp>
+
+#ifdef ENABLE_MPI
+#include <mpi.h>
+#endif
+
+namespace xenia
+{
+namespace utils
+{
+
+// Records how long each stage (read, each service, write) takes for every step on this rank.
+//  --timing file.csv|file.json writes the records, one file per rank when run on more than one rank.
+//  --timing-summary prints the min/max/avg over ranks of the total time in each stage on rank 0.
+class StepTimer
+{
+  public:
+  StepTimer() = default;
+  StepTimer(const boost::program_options::variables_map& vm);
+
+  bool GetEnabled() const { return !this->OutputFileName.empty() || this->Summary; }
+
+  //Safe to call from more than one thread.
+  void Record(vtkm::Id step, const std::string& stage, double seconds);
+
+  //Writes the records and the summary. Collective when the summary is enabled.
+  void Finish() const;
+
+  //Records the time from construction to destruction.
+  class Scope
+  {
+    public:
+    Scope(StepTimer& timer, vtkm::Id step, const std::string& stage)
+      : Timer(timer)
+      , Step(step)
+      , Stage(stage)
+      , Start(std::chrono::steady_clock::now())
+    {
+    }
+    ~Scope()
+    {
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - this->Start;
+      this->Timer.Record(this->Step, this->Stage, elapsed.count());
+    }
+
+    private:
+    StepTimer& Timer;
+    vtkm::Id Step;
+    std::string Stage;
+    std::chrono::steady_clock::time_point Start;
+  };
+
+  private:
+  struct Entry
+  {
+    vtkm::Id Step;
+    std::string Stage;
+    double Seconds;
+  };
+
+  std::string GetRankFileName() const;
+  void WriteRecords() const;
+  void WriteSummary() const;
+
+  std::vector<Entry> Entries;
+  mutable std::mutex Mutex;
+  std::string OutputFileName;
+  bool Summary = false;
+
+  int Rank = 0;
+  int NumRanks = 1;
+};
+
+}
+} //xenia::utils
@@ -0,0 +1,459 @@
+#include "VTKXMLWriter.h"
+
+#include <vtkm/cont/ArrayHandleCartesianProduct.h>
+#include <vtkm/cont/ArrayHandleUniformPointCoordinates.h>
+#include <vtkm/cont/CellSetExplicit.h>
+#include <vtkm/cont/CellSetSingleType.h>
+#include <vtkm/cont/CellSetStructured.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef XENIA_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace xenia
+{
+namespace utils
+{
+
+namespace
+{
+
+enum class GridType
+{
+  Image,
+  Rectilinear,
+  Structured,
+  Unstructured
+};
+
+template <typename T>
+using RectilinearCoordinates = vtkm::cont::ArrayHandleCartesianProduct<vtkm::cont::ArrayHandle<T>,
+                                                                       vtkm::cont::ArrayHandle<T>,
+                                                                       vtkm::cont::ArrayHandle<T>>;
+
+GridType
+GetGridType(const vtkm::cont::DataSet& ds)
+{
+  const auto& cellSet = ds.GetCellSet();
+  if (!cellSet.CanConvert<vtkm::cont::CellSetStructured<3>>() &&
+      !cellSet.CanConvert<vtkm::cont::CellSetStructured<2>>())
+    return GridType::Unstructured;
+
+  auto coords = ds.GetCoordinateSystem().GetData();
+  if (coords.CanConvert<vtkm::cont::ArrayHandleUniformPointCoordinates>())
+    return GridType::Image;
+  if (coords.CanConvert<RectilinearCoordinates<vtkm::Float32>>() ||
+      coords.CanConvert<RectilinearCoordinates<vtkm::Float64>>())
+    return GridType::Rectilinear;
+
+  return GridType::Structured;
+}
+
+vtkm::Id3
+GetPointDimensions(const vtkm::cont::UnknownCellSet& cellSet)
+{
+  if (cellSet.CanConvert<vtkm::cont::CellSetStructured<3>>())
+    return cellSet.AsCellSet<vtkm::cont::CellSetStructured<3>>().GetPointDimensions();
+
+  auto dims = cellSet.AsCellSet<vtkm::cont::CellSetStructured<2>>().GetPointDimensions();
+  return vtkm::Id3(dims[0], dims[1], 1);
+}
+
+std::string
+GetExtent(const vtkm::Id3& dims)
+{
+  std::ostringstream str;
+  str<<"0 "<<dims[0]-1<<" 0 "<<dims[1]-1<<" 0 "<<dims[2]-1;
+  return str.str();
+}
+
+const char*
+GetByteOrder()
+{
+  const std::uint16_t one = 1;
+  return (*reinterpret_cast<const char*>(&one) == 1 ? "LittleEndian" : "BigEndian");
+}
+
+std::string
+EscapeXML(const std::string& str)
+{
+  std::string out;
+  for (char c : str)
+  {
+    if (c == '&') out += "&amp;";
+    else if (c == '<') out += "&lt;";
+    else if (c == '>') out += "&gt;";
+    else if (c == '"') out += "&quot;";
+    else out += c;
+  }
+  return out;
+}
+
+template <typename T> const char* GetVTKTypeName();
+template <> const char* GetVTKTypeName<vtkm::Int8>() { return "Int8"; }
+template <> const char* GetVTKTypeName<vtkm::UInt8>() { return "UInt8"; }
+template <> const char* GetVTKTypeName<vtkm::Int16>() { return "Int16"; }
+template <> const char* GetVTKTypeName<vtkm::UInt16>() { return "UInt16"; }
+template <> const char* GetVTKTypeName<vtkm::Int32>() { return "Int32"; }
+template <> const char* GetVTKTypeName<vtkm::UInt32>() { return "UInt32"; }
+template <> const char* GetVTKTypeName<vtkm::Int64>() { return "Int64"; }
+template <> const char* GetVTKTypeName<vtkm::UInt64>() { return "UInt64"; }
+template <> const char* GetVTKTypeName<vtkm::Float32>() { return "Float32"; }
+template <> const char* GetVTKTypeName<vtkm::Float64>() { return "Float64"; }
+
+//An array in the appended data section, with the components of each value interleaved.
+struct DataArray
+{
+  std::string Name;
+  std::string Type;
+  vtkm::IdComponent NumberOfComponents = 1;
+  std::vector<char> Bytes;
+};
+
+template <typename T>
+DataArray
+MakeDataArray(const std::string& name, const std::vector<T>& values)
+{
+  DataArray out;
+  out.Name = name;
+  out.Type = GetVTKTypeName<T>();
+  out.Bytes.resize(values.size() * sizeof(T));
+  if (!values.empty())
+    std::memcpy(out.Bytes.data(), values.data(), out.Bytes.size());
+  return out;
+}
+
+template <typename T>
+bool
+ExtractArray(const vtkm::cont::UnknownArrayHandle& array, DataArray& out)
+{
+  if (!array.IsBaseComponentType<T>())
+    return false;
+
+  vtkm::IdComponent numComps = array.GetNumberOfComponentsFlat();
+  vtkm::Id numValues = array.GetNumberOfValues();
+  out.Type = GetVTKTypeName<T>();
+  out.NumberOfComponents = numComps;
+  out.Bytes.resize(static_cast<std::size_t>(numValues * numComps) * sizeof(T));
+
+  T* dest = reinterpret_cast<T*>(out.Bytes.data());
+  for (vtkm::IdComponent c = 0; c < numComps; c++)
+  {
+    auto portal = array.ExtractComponent<T>(c).ReadPortal();
+    for (vtkm::Id i = 0; i < numValues; i++)
+      dest[i*numComps + c] = portal.Get(i);
+  }
+  return true;
+}
+
+DataArray
+ToDataArray(const std::string& name, const vtkm::cont::UnknownArrayHandle& array)
+{
+  DataArray out;
+  out.Name = name;
+  if (!ExtractArray<vtkm::Float32>(array, out) && !ExtractArray<vtkm::Float64>(array, out) &&
+      !ExtractArray<vtkm::Int8>(array, out) && !ExtractArray<vtkm::UInt8>(array, out) &&
+      !ExtractArray<vtkm::Int16>(array, out) && !ExtractArray<vtkm::UInt16>(array, out) &&
+      !ExtractArray<vtkm::Int32>(array, out) && !ExtractArray<vtkm::UInt32>(array, out) &&
+      !ExtractArray<vtkm::Int64>(array, out) && !ExtractArray<vtkm::UInt64>(array, out))
+    throw std::runtime_error("Error. Unsupported array type for VTK XML output: " + name);
+
+  return out;
+}
+
+template <typename CellSetType>
+void
+GetExplicitCells(const CellSetType& cellSet,
+                 std::vector<vtkm::Int64>& conn,
+                 std::vector<vtkm::Int64>& offsets,
+                 std::vector<vtkm::UInt8>& types)
+{
+  vtkm::TopologyElementTagCell cellTag;
+  vtkm::TopologyElementTagPoint pointTag;
+  auto connPortal = cellSet.GetConnectivityArray(cellTag, pointTag).ReadPortal();
+  auto offsetsPortal = cellSet.GetOffsetsArray(cellTag, pointTag).ReadPortal();
+  auto shapesPortal = cellSet.GetShapesArray(cellTag, pointTag).ReadPortal();
+
+  vtkm::Id numCells = cellSet.GetNumberOfCells();
+  conn.resize(static_cast<std::size_t>(connPortal.GetNumberOfValues()));
+  for (vtkm::Id i = 0; i < connPortal.GetNumberOfValues(); i++)
+    conn[i] = connPortal.Get(i);
+
+  //VTK XML offsets are the end of each cell.
+  offsets.resize(static_cast<std::size_t>(numCells));
+  types.resize(static_cast<std::size_t>(numCells));
+  for (vtkm::Id i = 0; i < numCells; i++)
+  {
+    offsets[i] = offsetsPortal.Get(i+1);
+    types[i] = shapesPortal.Get(i);
+  }
+}
+
+void
+GetCells(const vtkm::cont::UnknownCellSet& cellSet,
+         std::vector<vtkm::Int64>& conn,
+         std::vector<vtkm::Int64>& offsets,
+         std::vector<vtkm::UInt8>& types)
+{
+  if (cellSet.CanConvert<vtkm::cont::CellSetSingleType<>>())
+    GetExplicitCells(cellSet.AsCellSet<vtkm::cont::CellSetSingleType<>>(), conn, offsets, types);
+  else if (cellSet.CanConvert<vtkm::cont::CellSetExplicit<>>())
+    GetExplicitCells(cellSet.AsCellSet<vtkm::cont::CellSetExplicit<>>(), conn, offsets, types);
+  else
+  {
+    //Any other cell set, one cell at a time.
+    std::vector<vtkm::Id> ids;
+    for (vtkm::Id i = 0; i < cellSet.GetNumberOfCells(); i++)
+    {
+      ids.resize(static_cast<std::size_t>(cellSet.GetNumberOfPointsInCell(i)));
+      cellSet.GetCellPointIds(i, ids.data());
+      conn.insert(conn.end(), ids.begin(), ids.end());
+      offsets.push_back(static_cast<vtkm::Int64>(conn.size()));
+      types.push_back(cellSet.GetCellShape(i));
+    }
+  }
+}
+
+//The appended data section. Each array is a UInt64 header followed by the data.
+//When compressed, the header is the number of blocks, the block size, the size of the last partial block
+//and the compressed size of each block, followed by the compressed blocks.
+class AppendedData
+{
+  public:
+  AppendedData(bool compress, int level, std::size_t blockSize)
+    : Compress(compress)
+    , Level(level)
+    , BlockSize(blockSize)
+  {
+  }
+
+  //Returns the offset of the array in the section.
+  std::size_t Add(const std::vector<char>& bytes)
+  {
+    std::size_t offset = this->Bytes.size();
+    if (this->Compress)
+      this->AddCompressed(bytes);
+    else
+    {
+      this->AddHeader(bytes.size());
+      this->Bytes.insert(this->Bytes.end(), bytes.begin(), bytes.end());
+    }
+    return offset;
+  }
+
+  const std::vector<char>& GetBytes() const { return this->Bytes; }
+
+  private:
+  void AddHeader(std::uint64_t val)
+  {
+    const char* ptr = reinterpret_cast<const char*>(&val);
+    this->Bytes.insert(this->Bytes.end(), ptr, ptr + sizeof(val));
+  }
+
+  void AddCompressed(const std::vector<char>& bytes)
+  {
+#ifdef XENIA_HAVE_ZLIB
+    std::size_t numBlocks = (bytes.size() + this->BlockSize - 1) / this->BlockSize;
+    std::vector<std::vector<char>> blocks(numBlocks);
+    for (std::size_t i = 0; i < numBlocks; i++)
+    {
+      std::size_t start = i * this->BlockSize;
+      std::size_t n = std::min(this->BlockSize, bytes.size() - start);
+      uLongf compressedSize = compressBound(static_cast<uLong>(n));
+      blocks[i].resize(compressedSize);
+      if (compress2(reinterpret_cast<Bytef*>(blocks[i].data()), &compressedSize,
+                    reinterpret_cast<const Bytef*>(bytes.data() + start), static_cast<uLong>(n), this->Level) != Z_OK)
+        throw std::runtime_error("Error. zlib compression failed.");
+      blocks[i].resize(compressedSize);
+    }
+
+    this->AddHeader(numBlocks);
+    this->AddHeader(this->BlockSize);
+    this->AddHeader(bytes.size() % this->BlockSize);
+    for (const auto& block : blocks)
+      this->AddHeader(block.size());
+    for (const auto& block : blocks)
+      this->Bytes.insert(this->Bytes.end(), block.begin(), block.end());
+#else
+    (void)bytes;
+    throw std::runtime_error("Error. Xenia was built without zlib, VTK XML compression is not available.");
+#endif
+  }
+
+  bool Compress;
+  int Level;
+  std::size_t BlockSize;
+  std::vector<char> Bytes;
+};
+
+void
+AddArray(std::ostream& xml, AppendedData& appended, const DataArray& array, const std::string& indent)
+{
+  auto offset = appended.Add(array.Bytes);
+  xml<<indent<<"<DataArray type=\""<<array.Type<<"\" Name=\""<<EscapeXML(array.Name)<<"\"";
+  if (array.NumberOfComponents > 1)
+    xml<<" NumberOfComponents=\""<<array.NumberOfComponents<<"\"";
+  xml<<" format=\"appended\" offset=\""<<offset<<"\"/>\n";
+}
+
+void
+AddFields(std::ostream& xml,
+          AppendedData& appended,
+          const vtkm::cont::DataSet& ds,
+          vtkm::cont::Field::Association association,
+          const std::string& tag)
+{
+  xml<<"      <"<<tag<<">\n";
+  for (vtkm::IdComponent i = 0; i < ds.GetNumberOfFields(); i++)
+  {
+    const auto& field = ds.GetField(i);
+    if (field.GetAssociation() != association || ds.HasCoordinateSystem(field.GetName()))
+      continue;
+    AddArray(xml, appended, ToDataArray(field.GetName(), field.GetData()), "        ");
+  }
+  xml<<"      </"<<tag<<">\n";
+}
+
+template <typename T>
+void
+AddRectilinearCoordinates(std::ostream& xml, AppendedData& appended, const vtkm::cont::UnknownArrayHandle& coords)
+{
+  auto axes = coords.AsArrayHandle<RectilinearCoordinates<T>>();
+  xml<<"      <Coordinates>\n";
+  AddArray(xml, appended, ToDataArray("x_coordinates", axes.GetFirstArray()), "        ");
+  AddArray(xml, appended, ToDataArray("y_coordinates", axes.GetSecondArray()), "        ");
+  AddArray(xml, appended, ToDataArray("z_coordinates", axes.GetThirdArray()), "        ");
+  xml<<"      </Coordinates>\n";
+}
+
+} //anonymous namespace
+
+VTKXMLWriter::VTKXMLWriter(bool compress)
+  : Compress(compress)
+{
+  if (this->Compress && !VTKXMLWriter::CompressionAvailable())
+    throw std::runtime_error("Error. Xenia was built without zlib, VTK XML compression is not available.");
+}
+
+bool
+VTKXMLWriter::CompressionAvailable()
+{
+#ifdef XENIA_HAVE_ZLIB
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::string
+VTKXMLWriter::GetExtension(const vtkm::cont::DataSet& ds)
+{
+  switch (GetGridType(ds))
+  {
+    case GridType::Image: return ".vti";
+    case GridType::Rectilinear: return ".vtr";
+    case GridType::Structured: return ".vts";
+    default: return ".vtu";
+  }
+}
+
+void
+VTKXMLWriter::Write(const vtkm::cont::DataSet& ds, const std::string& fileName) const
+{
+  auto gridType = GetGridType(ds);
+  const auto& cellSet = ds.GetCellSet();
+  auto coords = ds.GetCoordinateSystem().GetData();
+
+  AppendedData appended(this->Compress, this->CompressionLevel, this->BlockSize);
+  std::ostringstream xml;
+  std::string gridName;
+
+  //Grid and piece elements.
+  if (gridType == GridType::Image)
+  {
+    gridName = "ImageData";
+    auto uniform = coords.AsArrayHandle<vtkm::cont::ArrayHandleUniformPointCoordinates>();
+    auto origin = uniform.GetOrigin();
+    auto spacing = uniform.GetSpacing();
+    auto extent = GetExtent(GetPointDimensions(cellSet));
+    //Full precision, so the pieces of neighboring blocks line up.
+    auto precision = xml.precision(std::numeric_limits<double>::max_digits10);
+    xml<<"  <ImageData WholeExtent=\""<<extent<<"\" Origin=\""<<origin[0]<<" "<<origin[1]<<" "<<origin[2]
+       <<"\" Spacing=\""<<spacing[0]<<" "<<spacing[1]<<" "<<spacing[2]<<"\">\n";
+    xml.precision(precision);
+    xml<<"    <Piece Extent=\""<<extent<<"\">\n";
+  }
+  else if (gridType == GridType::Rectilinear || gridType == GridType::Structured)
+  {
+    gridName = (gridType == GridType::Rectilinear ? "RectilinearGrid" : "StructuredGrid");
+    auto extent = GetExtent(GetPointDimensions(cellSet));
+    xml<<"  <"<<gridName<<" WholeExtent=\""<<extent<<"\">\n";
+    xml<<"    <Piece Extent=\""<<extent<<"\">\n";
+  }
+  else
+  {
+    gridName = "UnstructuredGrid";
+    xml<<"  <UnstructuredGrid>\n";
+    xml<<"    <Piece NumberOfPoints=\""<<ds.GetNumberOfPoints()<<"\" NumberOfCells=\""<<ds.GetNumberOfCells()<<"\">\n";
+  }
+
+  AddFields(xml, appended, ds, vtkm::cont::Field::Association::Points, "PointData");
+  AddFields(xml, appended, ds, vtkm::cont::Field::Association::Cells, "CellData");
+
+  //Geometry. Image data needs none.
+  if (gridType == GridType::Rectilinear)
+  {
+    if (coords.CanConvert<RectilinearCoordinates<vtkm::Float32>>())
+      AddRectilinearCoordinates<vtkm::Float32>(xml, appended, coords);
+    else
+      AddRectilinearCoordinates<vtkm::Float64>(xml, appended, coords);
+  }
+  else if (gridType == GridType::Structured || gridType == GridType::Unstructured)
+  {
+    xml<<"      <Points>\n";
+    AddArray(xml, appended, ToDataArray("Points", coords), "        ");
+    xml<<"      </Points>\n";
+  }
+
+  if (gridType == GridType::Unstructured)
+  {
+    std::vector<vtkm::Int64> conn, offsets;
+    std::vector<vtkm::UInt8> types;
+    GetCells(cellSet, conn, offsets, types);
+    xml<<"      <Cells>\n";
+    AddArray(xml, appended, MakeDataArray("connectivity", conn), "        ");
+    AddArray(xml, appended, MakeDataArray("offsets", offsets), "        ");
+    AddArray(xml, appended, MakeDataArray("types", types), "        ");
+    xml<<"      </Cells>\n";
+  }
+  xml<<"    </Piece>\n";
+  xml<<"  </"<<gridName<<">\n";
+
+  std::ofstream fout(fileName, std::ios::binary);
+  if (!fout)
+    throw std::runtime_error("Error. Cannot open file for writing: " + fileName);
+
+  fout<<"<?xml version=\"1.0\"?>\n";
+  fout<<"<VTKFile type=\""<<gridName<<"\" version=\"1.0\" byte_order=\""<<GetByteOrder()<<"\" header_type=\"UInt64\"";
+  if (this->Compress)
+    fout<<" compressor=\"vtkZLibDataCompressor\"";
+  fout<<">\n";
+  fout<<xml.str();
+  fout<<"  <AppendedData encoding=\"raw\">\n   _";
+  const auto& bytes = appended.GetBytes();
+  fout.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  fout<<"\n  </AppendedData>\n";
+  fout<<"</VTKFile>\n";
+}
+
+}
+} //xenia::utils
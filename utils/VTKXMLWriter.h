@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+#include <vtkm/cont/DataSet.h>
+
+namespace xenia
+{
+namespace utils
+{
+
+// Writes a DataSet as a VTK XML file.
+// Uniform grids are written as .vti and rectilinear grids as .vtr, so no coordinates are stored for them.
+// Other structured grids are written as .vts, everything else as .vtu.
+// Arrays are stored as raw appended binary, optionally zlib compressed in blocks.
+class VTKXMLWriter
+{
+  public:
+  VTKXMLWriter(bool compress = false);
+
+  //File extension (e.g. ".vti") that Write uses for ds.
+  static std::string GetExtension(const vtkm::cont::DataSet& ds);
+
+  void Write(const vtkm::cont::DataSet& ds, const std::string& fileName) const;
+
+  static bool CompressionAvailable();
+
+  private:
+  bool Compress = false;
+  int CompressionLevel = 1;
+  std::size_t BlockSize = 32768;
+};
+
+}
+} //xenia::utils
@@ -1,18 +1,106 @@
 #include <stdio.h>
 #include "WriteData.h"
+#include "VTKXMLWriter.h"
 
 #include <vtkm/io/VTKDataSetWriter.h>
 #include <vtkm/cont/PartitionedDataSet.h>
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fstream>
 #include <numeric>
+#include <thread>
 
 namespace xenia
 {
 namespace utils
 {
 
+//Call writePartition(i) for each partition, using up to numThreads threads.
+template <typename Functor>
+static void
+ForEachPartition(vtkm::Id numDS, int numThreads, const Functor& writePartition)
+{
+  numThreads = static_cast<int>(std::min(static_cast<vtkm::Id>(numThreads), numDS));
+  if (numThreads <= 1)
+  {
+    for (vtkm::Id i = 0; i < numDS; i++)
+      writePartition(i);
+    return;
+  }
+
+  //Each thread takes the next unwritten partition until all are written.
+  std::atomic<vtkm::Id> next(0);
+  std::vector<std::exception_ptr> errors(numThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; t++)
+  {
+    threads.emplace_back([&, t]()
+    {
+      try
+      {
+        for (vtkm::Id i = next++; i < numDS; i = next++)
+          writePartition(i);
+      }
+      catch (...)
+      {
+        errors[t] = std::current_exception();
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  for (const auto& error : errors)
+    if (error)
+      std::rethrow_exception(error);
+}
+
+void
+WriteVTKPartitions(const vtkm::cont::PartitionedDataSet& pds,
+                   const std::vector<std::string>& fileNames,
+                   bool binary,
+                   int numThreads)
+{
+  vtkm::Id numDS = pds.GetNumberOfPartitions();
+  if (static_cast<vtkm::Id>(fileNames.size()) != numDS)
+    throw std::runtime_error("Error. Number of VTK file names does not match the number of partitions.");
+
+  ForEachPartition(numDS, numThreads, [&pds, &fileNames, binary](vtkm::Id i)
+  {
+    vtkm::io::VTKDataSetWriter writer(fileNames[i]);
+    if (binary)
+      writer.SetFileTypeToBinary();
+    else
+      writer.SetFileTypeToAscii();
+    writer.WriteDataSet(pds.GetPartition(i));
+  });
+}
+
+int
+GetNumberOfWriteThreads(const boost::program_options::variables_map& vm)
+{
+  if (!vm["write-threads"].empty())
+    return std::max(1, vm["write-threads"].as<int>());
+
+  int numThreads = static_cast<int>(std::thread::hardware_concurrency());
+#ifdef ENABLE_MPI
+  //Don't oversubscribe the node when several ranks share it.
+  MPI_Comm nodeComm;
+  int ranksOnNode = 1;
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &nodeComm);
+  MPI_Comm_size(nodeComm, &ranksOnNode);
+  MPI_Comm_free(&nodeComm);
+  numThreads /= ranksOnNode;
+#endif
+
+  return std::max(1, numThreads);
+}
+
 DataSetWriter::DataSetWriter(const boost::program_options::variables_map& vm)
 : Writer(nullptr)
+, OutputSteps(vm, "output-steps")
 {
 #ifdef ENABLE_MPI
   MPI_Comm_rank(MPI_COMM_WORLD, &this->Rank);
@@ -22,8 +110,20 @@ DataSetWriter::DataSetWriter(const boost::program_options::variables_map& vm)
     if (vm["output"].empty())
       throw std::runtime_error("No `--output` argument specified.");
     this->OutputFileName = vm["output"].as<std::string>();
-    if (this->OutputFileName.find(".vtk") != std::string::npos)
+    if (this->OutputFileName.find(".pvd") != std::string::npos)
+    {
+        this->OutputType = OutputFileType::VTKXML;
+        this->CompressVTKXML = (vm.count("vtk-compress") > 0);
+        if (this->CompressVTKXML && !VTKXMLWriter::CompressionAvailable())
+            throw std::runtime_error("Error. --vtk-compress requires Xenia to be built with zlib.");
+        this->NumWriteThreads = GetNumberOfWriteThreads(vm);
+    }
+    else if (this->OutputFileName.find(".vtk") != std::string::npos)
+    {
         this->OutputType = OutputFileType::VTK;
+        this->BinaryVTK = (vm.count("vtk-ascii") == 0);
+        this->NumWriteThreads = GetNumberOfWriteThreads(vm);
+    }
     else if (this->OutputFileName.find(".bp") != std::string::npos)
     {
         this->OutputType = OutputFileType::BP;
@@ -46,6 +146,8 @@ bool DataSetWriter::WriteDataSet(const vtkm::cont::PartitionedDataSet& pds)
 {
     if (this->OutputType == OutputFileType::VTK)
         return this->WriteVTK(pds);
+    else if (this->OutputType == OutputFileType::VTKXML)
+        return this->WriteVTKXML(pds);
     else if (this->Writer != nullptr)
     {
         if (this->OutputType == OutputFileType::BP)
@@ -65,11 +167,13 @@ DataSetWriter::Close()
 {
     if (this->Writer != nullptr)
         this->Writer->Close();
+    if (this->OutputType == OutputFileType::VTKXML)
+        this->WritePVDFile();
 }
 
 void DataSetWriter::CreateVisItFile(int totalNumDS)
 {
-    if (this->Rank != 0 || this->Step > 0)
+    if (this->Rank != 0 || this->NumStepsWritten > 0)
         return;
 
     auto pos = this->OutputFileName.find(".vtk");
@@ -120,24 +224,26 @@ std::vector<std::string> DataSetWriter::GetVTKOutputFileNames(int totalNumDS, in
 }
 
 
-bool DataSetWriter::WriteVTK(const vtkm::cont::PartitionedDataSet& pds)
+//Number of partitions on each rank, and the global block index range [b0, b1) of this rank.
+int DataSetWriter::GetGlobalBlockRange(int localNumDS, std::vector<int>& allNumDS, int& b0, int& b1) const
 {
-    int localNumDS = static_cast<int>(pds.GetNumberOfPartitions());
-    int totalNumDS = localNumDS;
-    int b0 = 0, b1 = localNumDS;
-#ifdef ENABLE_MPI
-    std::vector<int> allNumDS;
-    allNumDS.resize(this->NumRanks, 0);
+    allNumDS.assign(this->NumRanks, 0);
     allNumDS[this->Rank] = localNumDS;
+#ifdef ENABLE_MPI
     MPI_Allreduce(MPI_IN_PLACE, allNumDS.data(), this->NumRanks, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-    totalNumDS = std::accumulate(allNumDS.begin(), allNumDS.end(), 0);
+#endif
 
     //set block index bounds for this rank.
-    for (int i = 0; i < this->Rank; i++)
-        b0 += allNumDS[i];
+    b0 = std::accumulate(allNumDS.begin(), allNumDS.begin() + this->Rank, 0);
     b1 = b0 + localNumDS;
-    //std::cout<<this->Rank<<": "<<localNumDS<<" "<<totalNumDS<<" ("<<b0<<" "<<b1<<")"<<std::endl;
-#endif
+    return std::accumulate(allNumDS.begin(), allNumDS.end(), 0);
+}
+
+bool DataSetWriter::WriteVTK(const vtkm::cont::PartitionedDataSet& pds)
+{
+    int b0 = 0, b1 = 0;
+    std::vector<int> allNumDS;
+    int totalNumDS = this->GetGlobalBlockRange(static_cast<int>(pds.GetNumberOfPartitions()), allNumDS, b0, b1);
 
     if (totalNumDS == 0)
         return false;
@@ -145,18 +251,82 @@ bool DataSetWriter::WriteVTK(const vtkm::cont::PartitionedDataSet& pds)
     this->CreateVisItFile(totalNumDS);
     this->AppendVTKFiles(totalNumDS);
     auto outputFileNames = this->GetVTKOutputFileNames(totalNumDS, b0, b1);
+    WriteVTKPartitions(pds, outputFileNames, this->BinaryVTK, this->NumWriteThreads);
+
+    return true;
+}
 
-    int blkIdx = 0;
-    for (const auto& ds : pds.GetPartitions())
+bool DataSetWriter::WriteVTKXML(const vtkm::cont::PartitionedDataSet& pds)
+{
+    int localNumDS = static_cast<int>(pds.GetNumberOfPartitions());
+    int b0 = 0, b1 = 0;
+    std::vector<int> allNumDS;
+    int totalNumDS = this->GetGlobalBlockRange(localNumDS, allNumDS, b0, b1);
+    if (totalNumDS == 0)
+        return false;
+
+    //foo.pvd --> foo.ts_<step>_ds_<block>.<vti|vtr|vts|vtu>
+    std::string baseName = this->OutputFileName.substr(0, this->OutputFileName.rfind(".pvd"));
+    std::string extensions;
+    std::vector<std::string> outputFileNames;
+    for (int i = 0; i < localNumDS; i++)
     {
-        vtkm::io::VTKDataSetWriter writer(outputFileNames[blkIdx]);
-        writer.WriteDataSet(ds);
-        blkIdx++;
+        auto ext = VTKXMLWriter::GetExtension(pds.GetPartition(i));
+        extensions += ext.substr(1);
+        outputFileNames.push_back(baseName + ".ts_" + std::to_string(this->Step) + "_ds_" + std::to_string(b0+i) + ext);
+    }
+
+    VTKXMLWriter writer(this->CompressVTKXML);
+    ForEachPartition(localNumDS, this->NumWriteThreads, [&pds, &outputFileNames, &writer](vtkm::Id i)
+    {
+        writer.Write(pds.GetPartition(i), outputFileNames[i]);
+    });
+
+    //Rank 0 records every block of the step for the .pvd file. Each extension is 3 characters.
+    std::string allExtensions = extensions;
+#ifdef ENABLE_MPI
+    std::vector<int> counts(this->NumRanks), displs(this->NumRanks, 0);
+    for (int i = 0; i < this->NumRanks; i++)
+    {
+        counts[i] = 3 * allNumDS[i];
+        if (i > 0)
+            displs[i] = displs[i-1] + counts[i-1];
+    }
+    allExtensions.resize(3 * totalNumDS);
+    MPI_Gatherv(extensions.data(), static_cast<int>(extensions.size()), MPI_CHAR,
+                &allExtensions[0], counts.data(), displs.data(), MPI_CHAR, 0, MPI_COMM_WORLD);
+#endif
+
+    if (this->Rank == 0)
+    {
+        //Files in the .pvd are relative to its directory.
+        auto pos = baseName.find_last_of('/');
+        std::string localName = (pos == std::string::npos ? baseName : baseName.substr(pos+1));
+        for (int i = 0; i < totalNumDS; i++)
+        {
+            std::string fileName = localName + ".ts_" + std::to_string(this->Step) + "_ds_" + std::to_string(i) + "." + allExtensions.substr(3*i, 3);
+            this->PVDEntries.push_back({this->Step, i, fileName});
+        }
     }
 
     return true;
 }
 
+void DataSetWriter::WritePVDFile() const
+{
+    if (this->Rank != 0 || this->PVDEntries.empty())
+        return;
+
+    std::ofstream fout(this->OutputFileName);
+    fout<<"<?xml version=\"1.0\"?>"<<std::endl;
+    fout<<"<VTKFile type=\"Collection\" version=\"1.0\">"<<std::endl;
+    fout<<"  <Collection>"<<std::endl;
+    for (const auto& entry : this->PVDEntries)
+        fout<<"    <DataSet timestep=\""<<entry.Step<<"\" part=\""<<entry.Part<<"\" file=\""<<entry.FileName<<"\"/>"<<std::endl;
+    fout<<"  </Collection>"<<std::endl;
+    fout<<"</VTKFile>"<<std::endl;
+}
+
 bool DataSetWriter::WriteBP(const vtkm::cont::PartitionedDataSet& pds)
 {
     if (this->Writer == nullptr)
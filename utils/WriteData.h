@@ -5,8 +5,10 @@
 #include <boost/program_options.hpp>
 
 #include <fides/DataSetWriter.h>
+#include "StepRange.h"
 #include <string>
 #include <regex>
+#include <vector>
 
 #ifdef ENABLE_MPI
 #include <mpi.h>
@@ -52,6 +54,16 @@ WriteData(const vtkm::cont::PartitionedDataSet& pds, const std::string& outName)
   }
 }
 
+//Write each partition of pds to the matching file name.
+//Partitions are written concurrently by up to numThreads threads.
+void WriteVTKPartitions(const vtkm::cont::PartitionedDataSet& pds,
+                        const std::vector<std::string>& fileNames,
+                        bool binary,
+                        int numThreads);
+
+//Number of threads for writing partitions: --write-threads, or the cores on the node divided over the ranks on the node.
+int GetNumberOfWriteThreads(const boost::program_options::variables_map& vm);
+
 class DataSetWriter
 {
   public:
@@ -59,10 +71,16 @@ class DataSetWriter
 
   bool WriteDataSet(const vtkm::cont::PartitionedDataSet& pds);
 
+  //The step labels the output: VTK file names and the .pvd timestep. Without it, the step after the last one is used.
   void BeginStep() {}
-  void EndStep() {this->Step++;}
+  void BeginStep(vtkm::Id step) {this->Step = step;}
+  void EndStep() {this->Step++; this->NumStepsWritten++;}
   void Close();
 
+  //Only the steps in --output-steps start:stop:stride are written. For SST output the other
+  //steps are never sent to the consumer.
+  bool IsStepSelected(vtkm::Id step) const { return this->OutputSteps.Contains(step); }
+
   void SetTimeVaryingOutput(bool val) { this->TimeVaryingOutput = val; }
   bool GetTimeVaryingOutput() const { return this->TimeVaryingOutput; }
 
@@ -72,22 +90,47 @@ class DataSetWriter
     VTK = 1,
     BP = 2,
     SST = 3,
+    VTKXML = 4,
   };
 
+  //Every rank needs to call WriteDataSet each step, even with no partitions. The VTK index files are
+  //gathered over the ranks, and the BP/SST steps are collective in ADIOS.
+  bool GetWritesCollective() const
+  {
+    return this->OutputType != OutputFileType::NONE;
+  }
+
   bool WriteVTK(const vtkm::cont::PartitionedDataSet& pds);
+  bool WriteVTKXML(const vtkm::cont::PartitionedDataSet& pds);
   bool WriteBP(const vtkm::cont::PartitionedDataSet& pds);
 
   private:
   void CreateVisItFile(int totalNumDS);
   void AppendVTKFiles(int totalNumDS) const;
   std::vector<std::string> GetVTKOutputFileNames(int totalNumDS, int blk0, int blk1) const;
+  int GetGlobalBlockRange(int localNumDS, std::vector<int>& allNumDS, int& b0, int& b1) const;
+  void WritePVDFile() const;
   std::string VisItFileName;
 
+  //Files written so far, for the .pvd time index written by rank 0 on Close.
+  struct PVDEntry
+  {
+    vtkm::Id Step;
+    int Part;
+    std::string FileName;
+  };
+  std::vector<PVDEntry> PVDEntries;
+
   OutputFileType OutputType = OutputFileType::NONE;
   std::string OutputFileName;
   std::unique_ptr<fides::io::DataSetAppendWriter> Writer;
   vtkm::Id Step = 0;
+  vtkm::Id NumStepsWritten = 0;
+  StepRange OutputSteps;
   bool TimeVaryingOutput = false;
+  bool BinaryVTK = true;
+  bool CompressVTKXML = false;
+  int NumWriteThreads = 1;
 
   int Rank = 0;
   int NumRanks = 1;